@@ -16,6 +16,8 @@
 #include "aup/catalog/file.hpp"
 #include "aup/catalog/unit.hpp"
 #include "aup/catalog/release.hpp"
+#include "aup/catalog/delta.hpp"
+#include "aup/catalog/chunked.hpp"
 #include "aup/catalog/identify.hpp"
 
 #include "aup/applier.hpp"
@@ -13,7 +13,10 @@
 #include "oid.hpp"
 #include "applier/task.hpp"
 #include "applier/result.hpp"
+#include "applier/plan.hpp"
 #include "catalog/file.hpp"
+#include <optional>
+#include <chrono>
 
 namespace dci::aup
 {
@@ -38,7 +41,22 @@ namespace dci::aup
         void addStorage(Storage* s);
         void addRoot(const Oid& oid, const Set<catalog::File::Kind>& fileKinds);
 
+        //кэш состояния файлов цели, хранится в s под localPath;
+        //записи, изменившиеся ближе racyWindow к сохранению кэша, не доверяются (гранулярность времени в фс)
+        void setStatCache(Storage* s, const String& localPath, std::chrono::nanoseconds racyWindow = std::chrono::seconds{2});
+
+        //пути (относительно места), изменявшиеся с прошлого применения; при nullopt (по умолчанию) место проверяется полностью,
+        //иначе остальное берется из кэша состояния как есть (без tShadow и tParanoid)
+        void setDirty(const std::optional<Set<String>>& paths);
+
     public:
         applier::Result process(const String& place, applier::Task task = applier::tNull);
+
+        //разбор и решения без изменений в месте, затем исполнение готового плана
+        applier::Plan plan(const String& place, applier::Task task = applier::tNull);
+        applier::Result execute(const applier::Plan& plan);
+
+        //обмен места с деревом, оставленным теневым режимом (tShadow)
+        bool rollback(const String& place);
     };
 }
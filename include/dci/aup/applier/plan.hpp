@@ -0,0 +1,59 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+#pragma once
+
+#include "../api.hpp"
+#include "../oid.hpp"
+#include <dci/bytes.hpp>
+#include <string>
+#include <vector>
+
+namespace dci::aup::applier
+{
+    struct Action
+    {
+        enum class Kind : uint8
+        {
+            remove  = 1,
+            emplace = 2,
+            update  = 3,
+            chmod   = 4,
+            link    = 5,//перенос неизменного файла в теневое дерево
+        };
+
+        Kind        _kind {};
+        std::string _path;//относительно места
+        Oid         _content {};
+        uint16      _perms {};
+        uint64      _size {};//байт к записи
+    };
+
+    /* план приведения места к каталогу, строится без изменений в месте, исполняется отдельно
+     *
+     * действия в порядке исполнения, _result - биты, известные на момент построения (отсутствующее, лишнее, без исправления);
+     * пути - относительные и без "..", иначе исполнение отвергает план целиком;
+     * построение ничего не сохраняет, кэш состояния места обновляет только исполнение
+     */
+    struct Plan
+    {
+        std::string             _place;
+        uint64                  _task {};
+        uint64                  _result {};
+
+        std::vector<Action>     _actions;
+
+        //для уборки опустевших каталогов после исполнения
+        std::vector<std::string> _dirs;
+        Set<std::string>        _extraAllowed;
+
+        uint64 bytes() const;
+    };
+
+    Bytes API_DCI_AUP serialize(const Plan& plan);
+    Plan API_DCI_AUP deserialize(Bytes&& blob);
+}
@@ -19,12 +19,16 @@ namespace dci::aup::applier
         tVerboseMinor      = 0x2,
         tVerbose           = 0x3,
         tCheckStorage      = 0x4,
+        tParanoid          = 0x8,//не доверять кэшу состояния файлов, пересчитать содержимое всех
 
         tRemoveWrongs      = 0x10,
         tEmplaceMissings   = 0x20,
         tEmplaceChanges    = 0x40,
         tRemoveExtra       = 0x80,
 
+        tParallel          = 0x100,//создание и обновление файлов на пуле потоков
+        tShadow            = 0x200,//новое дерево строится рядом и подменяет место атомарно, прежнее остается для отката
+
         tAll               = ~uint64{}
     };
 }
@@ -41,5 +41,8 @@ namespace dci::aup
         bool has(const Oid& oid);
         catalog::ObjectPtr get(const Oid& oid);
         void del(const Oid& oid);
+
+    public://доступ без копирования, указатель валиден до изменения каталога
+        const catalog::Object* find(const Oid& oid) const;
     };
 }
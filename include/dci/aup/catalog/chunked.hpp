@@ -0,0 +1,40 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+
+#pragma once
+
+#include "../api.hpp"
+#include "object.hpp"
+#include <dci/bytes.hpp>
+#include <vector>
+
+namespace dci::aup::catalog
+{
+    /* содержимое _target, нарезанное на куски по самому содержимому (FastCDC)
+     *
+     * куски - обычные объекты хранилища под своими идентификаторами, _chunks и _chunkSizes - по порядку,
+     * файл ссылается на свою нарезку через _dependencies; правка в середине большого файла меняет лишь
+     * соседние с ней куски, остальные уже есть в прежних версиях
+     */
+    struct Chunked : Object
+    {
+        Oid                 _target {};
+        uint64              _size {};
+        std::vector<Oid>    _chunks;
+        std::vector<uint64> _chunkSizes;
+
+        static constexpr Type _staticType = Object::Type::chunked;
+        Type type() const override {return _staticType;}
+    };
+
+    using ChunkedPtr = std::unique_ptr<Chunked>;
+
+    //размеры кусков по порядку, в сумме - размер содержимого
+    std::vector<uint64> API_DCI_AUP chunkSizes(const void* data, uint64 size);
+    std::vector<uint64> API_DCI_AUP chunkSizes(const Bytes& blob);
+}
@@ -0,0 +1,46 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+
+#pragma once
+
+#include "../api.hpp"
+#include "object.hpp"
+#include <dci/bytes.hpp>
+#include <functional>
+
+namespace dci::aup::catalog
+{
+    /* содержимое _target, закодированное относительно содержимого _base
+     *
+     * тело дельты лежит в хранилище под _content, восстановленное содержимое проверяется по _target,
+     * файл ссылается на свои дельты через _dependencies
+     */
+    struct Delta : Object
+    {
+        Oid     _base {};
+        Oid     _target {};
+        uint64  _size {};
+        Oid     _content {};
+
+        static constexpr Type _staticType = Object::Type::delta;
+        Type type() const override {return _staticType;}
+    };
+
+    using DeltaPtr = std::unique_ptr<Delta>;
+
+    //тело дельты: копирования из base и вставки литералов
+    Bytes API_DCI_AUP makeDelta(const void* base, uint64 baseSize, const void* target, uint64 targetSize);
+    Bytes API_DCI_AUP makeDelta(const Bytes& base, const Bytes& target);
+
+    //восстановление target, при несоответствии дельты и base - aup::Exception
+    Bytes API_DCI_AUP applyDelta(const void* base, uint64 baseSize, const Bytes& delta);
+    Bytes API_DCI_AUP applyDelta(const Bytes& base, const Bytes& delta);
+
+    //то же без сборки target в памяти: восстановленное отдается в sink кусками по порядку
+    void API_DCI_AUP applyDelta(const void* base, uint64 baseSize, const void* delta, uint64 deltaSize, const std::function<void(const uint8*, uint64)>& sink);
+}
@@ -37,10 +37,11 @@ namespace dci::aup::catalog
         Kind            _kind {};
         std::string     _path;
         uint16          _perms {};
-        uint32          _size {};
+        uint64          _size {};
         Oid             _content {};
 
-        Object::Type type() const override {return Object::Type::file;}
+        static constexpr Object::Type _staticType = Object::Type::file;
+        Object::Type type() const override {return _staticType;}
     };
 
     using FilePtr = std::unique_ptr<File>;
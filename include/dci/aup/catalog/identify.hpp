@@ -16,5 +16,6 @@ namespace dci::aup::catalog
 {
     Oid API_DCI_AUP identify(const Bytes& blob);
     Oid API_DCI_AUP identify(std::FILE* f);
+    Oid API_DCI_AUP identify(const void* data, uint64 size);
     Oid API_DCI_AUP identify(const catalog::Object* object);
 }
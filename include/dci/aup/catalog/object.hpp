@@ -17,22 +17,23 @@ namespace dci::aup::catalog
     struct Object;
     using ObjectPtr = std::unique_ptr<Object>;
 
+    //по типу объекта, без RTTI
     template <class To, class From>
     To* objectPtrCast(From* from)
     {
-        return dynamic_cast<To*>(from);
+        return from && To::_staticType == from->type() ? static_cast<To*>(from) : nullptr;
     }
 
     template <class To, class From>
     const To* objectPtrCast(const From* from)
     {
-        return dynamic_cast<const To*>(from);
+        return from && To::_staticType == from->type() ? static_cast<const To*>(from) : nullptr;
     }
 
     template <class To, class From>
     std::unique_ptr<To> objectPtrCast(std::unique_ptr<From>&& from)
     {
-        To* to = dynamic_cast<To*>(from.get());
+        To* to = objectPtrCast<To>(from.get());
         if(to)
         {
             from.release();
@@ -51,6 +52,8 @@ namespace dci::aup::catalog
             file        = 1,
             unit        = 2,
             release     = 3,
+            delta       = 4,
+            chunked     = 5,
         };
 
         Set<Oid>   _dependencies;
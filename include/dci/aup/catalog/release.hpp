@@ -29,7 +29,8 @@ namespace dci::aup::catalog
         Array<uint8, 32> _signer {};
         Array<uint8, 64> _signature {};
 
-        Type type() const override {return Object::Type::release;}
+        static constexpr Type _staticType = Object::Type::release;
+        Type type() const override {return _staticType;}
     };
 
     using ReleasePtr = std::unique_ptr<Release>;
@@ -16,7 +16,8 @@ namespace dci::aup::catalog
         std::string         _name;
         Set<std::string>    _extraAllowed;
 
-        Type type() const override {return Object::Type::unit;}
+        static constexpr Type _staticType = Object::Type::unit;
+        Type type() const override {return _staticType;}
     };
 
     using UnitPtr = std::unique_ptr<Unit>;
@@ -9,7 +9,9 @@
 
 #include "../api.hpp"
 #include "../oid.hpp"
+#include "../storage/mapping.hpp"
 #include <optional>
+#include <vector>
 #include <dci/bytes.hpp>
 
 namespace dci::aup::instance::io
@@ -34,7 +36,8 @@ namespace dci::aup::instance::io
     API_DCI_AUP bool hasStorageObject(const Oid& oid);
 
     API_DCI_AUP std::optional<Bytes> getCatalogObject(const Oid& oid);
-    API_DCI_AUP std::optional<Bytes> getStorageObject(const Oid& oid, uint32 from=0, uint32 to=~uint32{});
+    API_DCI_AUP std::optional<Bytes> getStorageObject(const Oid& oid, uint64 from=0, uint64 to=~uint64{});
+    API_DCI_AUP std::optional<storage::Mapping> mapStorageObject(const Oid& oid);
 
     enum class PutObjectResult
     {
@@ -53,4 +56,15 @@ namespace dci::aup::instance::io
 
     using StdFilePtr = std::unique_ptr<std::FILE, StdFileDeleter>;
     API_DCI_AUP PutObjectResult putStorageObject(const Oid& oid, StdFilePtr f);
+
+    /* диапазоны содержимого, проверяемые сами по себе, без содержимого целиком
+     *
+     * границы диапазонов - границы кусков нарезки содержимого (catalog::Chunked), каждый кусок сверяется со своим
+     * идентификатором, а нарезка подтверждена каталогом; диапазоны можно брать у разных источников параллельно
+     * storageObjectChunks - размеры кусков по порядку, пусто - нарезки нет и проверяется только объект целиком
+     * putStorageObjectRange принимает целые куски с offset, содержимое собирается с приходом последнего
+     */
+    API_DCI_AUP std::vector<uint64> storageObjectChunks(const Oid& oid);
+    API_DCI_AUP bool verifyStorageObjectRange(const Oid& oid, uint64 offset, const Bytes& blob);
+    API_DCI_AUP PutObjectResult putStorageObjectRange(const Oid& oid, uint64 offset, Bytes&& blob);
 }
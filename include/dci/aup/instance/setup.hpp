@@ -11,10 +11,13 @@
 #include "../oid.hpp"
 #include <vector>
 #include <string>
+#include <boost/property_tree/ptree_fwd.hpp>
 
 namespace dci::aup::instance::setup
 {
     API_DCI_AUP void start(const std::vector<std::string>& args);
+    API_DCI_AUP void start(const boost::property_tree::ptree& config);//уже разобранная конфигурация
+    API_DCI_AUP void stop();
 
     API_DCI_AUP bool targetComplete();
     API_DCI_AUP void updateTarget();
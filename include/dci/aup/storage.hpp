@@ -11,6 +11,7 @@
 #include <dci/aup/implMetaInfo.hpp>
 #include "api.hpp"
 #include "oid.hpp"
+#include "storage/mapping.hpp"
 #include <dci/bytes.hpp>
 #include <optional>
 
@@ -34,10 +35,33 @@ namespace dci::aup
          * в случае ошибок нижнего слоя (файловая система)
          *      при взведеном флаге autoFixIfCan будет предпринята попытка исправить ситуацию, даже если для исправления потребуется утерять информацию
          *      если исправить не удалось или флажок вообще не взведен - будет бросаться исключение
+         *
+         * размещение
+         *      по умолчанию каждый объект лежит в отдельном файле <place>/xx/<62 hex>
+         *      при взведенном флаге packed новые объекты дописываются в pack-файлы <place>/pack/, место от удаленных объектов возвращается через compact
+         *      объекты читаются из обоих размещений независимо от флага
+         *
+         * сжатие
+         *      при взведенном флаге compressed отдельно лежащие объекты пишутся сжатыми независимыми кадрами zstd, несжимаемые - как есть
+         *      сжатые объекты читаются прозрачно независимо от флага, диапазон - разжатием только покрывающих его кадров
+         *
+         * запись
+         *      объект пишется во временный файл, сбрасывается на носитель и только потом получает свое имя
+         *      между batchBegin и batchCommit сброс откладывается и выполняется разом для всех записанных объектов,
+         *      до batchCommit такие объекты уже видны через has/get/map, но после сбоя могут пропасть
+         *
+         * чтение
+         *      get копирует данные в Bytes
+         *      map отображает объект в память без копирования, данные живут пока жив Mapping
+         *      сжатый объект map разжимает в собственный буфер Mapping
          */
 
     public:
-        void reset(const std::string& place, bool autoFixIfCan=true);
+        void reset(const std::string& place, bool autoFixIfCan=true, bool packed=false, bool compressed=false);
+        uint64 compact();
+
+        void batchBegin();
+        void batchCommit();
 
     public:
         Set<Oid> enumerate();
@@ -45,12 +69,14 @@ namespace dci::aup
     public:
         void put(const std::string& localPath, Bytes&& blob);
         bool has(const std::string& localPath);
-        std::optional<Bytes> get(const std::string& localPath, uint32 from=0, uint32 to=~uint32{0});
+        std::optional<Bytes> get(const std::string& localPath, uint64 from=0, uint64 to=~uint64{0});
+        std::optional<storage::Mapping> map(const std::string& localPath);
         bool del(const std::string& localPath);
 
         void put(const Oid& oid, Bytes&& blob);
         bool has(const Oid& oid);
-        std::optional<Bytes> get(const Oid& oid, uint32 from=0, uint32 to=~uint32{0});
+        std::optional<Bytes> get(const Oid& oid, uint64 from=0, uint64 to=~uint64{0});
+        std::optional<storage::Mapping> map(const Oid& oid);
         bool del(const Oid& oid);
 
         void delAll(bool andPlaceDirectory = true);
@@ -0,0 +1,52 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+#pragma once
+
+#include "../api.hpp"
+#include <dci/primitives.hpp>
+#include <filesystem>
+
+namespace dci::aup::storage
+{
+    /* отображенный в память объект хранилища, только для чтения
+     *
+     * данные валидны пока жив экземпляр, отображение снимается в деструкторе
+     */
+    class API_DCI_AUP Mapping
+    {
+        Mapping(const Mapping&) = delete;
+        void operator=(const Mapping&) = delete;
+
+    public:
+        Mapping();
+        Mapping(Mapping&& from);
+        ~Mapping();
+
+        Mapping& operator=(Mapping&& from);
+
+    public:
+        void open(const std::filesystem::path& path, uint64 offset=0, uint64 size=~uint64{0});
+        void close();
+
+        //вместо отображения - собственный буфер под заполнение, например разжатым содержимым
+        uint8* allocate(uint64 size);
+
+    public:
+        const uint8* data() const;
+        uint64 size() const;
+
+    private:
+        void*           _base {};
+        std::size_t     _baseSize {};
+
+        const uint8*    _data {};
+        uint64          _size {};
+
+        bool            _owned {};
+    };
+}
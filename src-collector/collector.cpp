@@ -33,7 +33,10 @@ namespace dci::aup
             _aupCatalog.deserialize(std::move(*prevCatalogBlob));
         }
 
+        _aupStorage.batchBegin();
         processFiles();
+        _aupStorage.batchCommit();
+
         fixRelease();
 
         _aupStorage.put("catalog", _aupCatalog.serialize());
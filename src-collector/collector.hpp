@@ -33,6 +33,7 @@ namespace dci::aup
         void setIgnoreSources(bool v);
         void setIgnoreDebug4Targets(bool v);
         void setIgnoreDebug4Others(bool v);
+        void setChunkedFrom(uint64 v);
 
         void run();
 
@@ -40,7 +41,7 @@ namespace dci::aup
         void loadMeta();
 
     private://processing
-        Oid processFileContent(const fs::path& p);
+        Oid processFileContent(const fs::path& p, Set<Oid>& dependencies);
 
         collector::AbsAndRel absAndRel(const collector::Meta& meta, const fs::path& file);
         collector::AbsAndRel absAndRel(const collector::Meta& meta, const collector::AbsAndRel& file);
@@ -69,6 +70,7 @@ namespace dci::aup
         bool                                    _ignoreSources {true};
         bool                                    _ignoreDebug4Targets {true};
         bool                                    _ignoreDebug4Others {true};
+        uint64                                  _chunkedFrom {};//0 - без нарезки
 
     private:
         collector::Meta                         _globalMeta;
@@ -50,7 +50,7 @@ namespace dci::aup
     }
 
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
-    Oid Collector::processFileContent(const fs::path& p)
+    Oid Collector::processFileContent(const fs::path& p, Set<Oid>& dependencies)
     {
         assert(p.is_absolute());
 
@@ -86,8 +86,33 @@ namespace dci::aup
         }
 
         Oid oid = catalog::identify(blob);
+        uint64 size = blob.size();
         _aupStorage.put(oid, std::move(blob));
 
+        if(_chunkedFrom && size >= _chunkedFrom)
+        {
+            //куски в хранилище отдельно не кладутся, они отдаются из самого содержимого
+            std::optional<storage::Mapping> m = _aupStorage.map(oid);
+            if(!m)
+            {
+                throw std::runtime_error{"unable to map just stored content of "+p.string()};
+            }
+
+            catalog::ChunkedPtr c{std::make_unique<catalog::Chunked>()};
+            c->_target = oid;
+            c->_size = m->size();
+            c->_chunkSizes = catalog::chunkSizes(m->data(), m->size());
+
+            uint64 offset{};
+            for(uint64 chunkSize : c->_chunkSizes)
+            {
+                c->_chunks.push_back(catalog::identify(m->data() + offset, chunkSize));
+                offset += chunkSize;
+            }
+
+            dependencies.insert(_aupCatalog.put(std::move(c)));
+        }
+
         return oid;
     }
 
@@ -234,8 +259,8 @@ namespace dci::aup
             dbgF->_kind = catalog::File::Kind::debug;
             dbgF->_path = dbg.rel().string();
             dbgF->_perms = static_cast<uint16>(fs::status(dbg.abs()).permissions()) & 0777;
-            dbgF->_size = static_cast<uint32>(fs::file_size(dbg.abs()));
-            dbgF->_content = processFileContent(dbg.abs());
+            dbgF->_size = fs::file_size(dbg.abs());
+            dbgF->_content = processFileContent(dbg.abs(), dbgF->_dependencies);
 
             _processedFiles[dbg] = _aupCatalog.put(std::move(dbgF));
         }
@@ -275,8 +300,8 @@ namespace dci::aup
         f->_kind = kind;
         f->_path = file.rel().string();
         f->_perms = static_cast<uint16>(fs::status(file.abs()).permissions()) & 0777;
-        f->_size = static_cast<uint32>(fs::file_size(file.abs()));
-        f->_content = processFileContent(file.abs());
+        f->_size = fs::file_size(file.abs());
+        f->_content = processFileContent(file.abs(), f->_dependencies);
 
         _processedFiles[file] = _aupCatalog.put(std::move(f));
         return {file};
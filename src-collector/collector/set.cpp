@@ -62,4 +62,10 @@ namespace dci::aup
     {
         _ignoreDebug4Others = v;
     }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Collector::setChunkedFrom(uint64 v)
+    {
+        _chunkedFrom = v;
+    }
 }
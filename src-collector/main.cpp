@@ -56,6 +56,11 @@ int main(int argc, char* argv[])
                     po::bool_switch()->notifier([&](auto v){c.setIgnoreDebug4Others(!v);}),
                     "collect debug info for non-dci executable files and libraries"
                 )
+                (
+                    "chunked-from",
+                    po::value<dci::uint64>()->notifier([&](auto v){c.setChunkedFrom(v);}),
+                    "describe files of this size and above also as content-defined chunks, 0 - never"
+                )
                 ;
 
         ////////////////////////////////////////////////////////////////////////////////
@@ -41,9 +41,44 @@ namespace dci::aup
         return impl().addRoot(oid, fileKinds);
     }
 
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Applier::setStatCache(Storage* s, const String& localPath, std::chrono::nanoseconds racyWindow)
+    {
+        return impl().setStatCache(himpl::face2Impl(s), localPath, racyWindow);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Applier::setDirty(const std::optional<Set<String>>& paths)
+    {
+        if(!paths)
+        {
+            return impl().setDirty({});
+        }
+
+        return impl().setDirty(std::set<std::string>{paths->begin(), paths->end()});
+    }
+
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     applier::Result Applier::process(const String& place, applier::Task task)
     {
         return impl().process(place, task);
     }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    applier::Plan Applier::plan(const String& place, applier::Task task)
+    {
+        return impl().plan(place, task);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    applier::Result Applier::execute(const applier::Plan& plan)
+    {
+        return impl().execute(plan);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    bool Applier::rollback(const String& place)
+    {
+        return impl().rollback(place);
+    }
 }
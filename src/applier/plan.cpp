@@ -0,0 +1,151 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+#include <dci/aup/applier/plan.hpp>
+#include <dci/aup/catalog/identify.hpp>
+#include <dci/aup/exception.hpp>
+#include <dci/stiac/serialization.hpp>
+
+namespace dci::aup::applier
+{
+    namespace
+    {
+        constexpr uint64 g_magic = 0x51c9a4e2870b3df6;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    uint64 Plan::bytes() const
+    {
+        uint64 res {};
+        for(const Action& a : _actions)
+        {
+            res += a._size;
+        }
+
+        return res;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    Bytes serialize(const Plan& plan)
+    {
+        Bytes blob;
+
+        {
+            stiac::serialization::Arch arch{blob.begin()};
+
+            arch << g_magic;
+            arch << plan._place << plan._task << plan._result;
+
+            arch << stiac::smallIntegral(uint64{plan._actions.size()});
+            for(const Action& a : plan._actions)
+            {
+                arch << static_cast<uint8>(a._kind) << a._path << a._content << a._perms << stiac::smallIntegral(a._size);
+            }
+
+            arch << stiac::smallIntegral(uint64{plan._dirs.size()});
+            for(const std::string& dir : plan._dirs)
+            {
+                arch << dir;
+            }
+
+            arch << stiac::smallIntegral(uint64{plan._extraAllowed.size()});
+            for(const std::string& pattern : plan._extraAllowed)
+            {
+                arch << pattern;
+            }
+
+            //check
+            Oid check = catalog::identify(blob);
+            blob.end().write(check);
+        }
+
+        return blob;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    Plan deserialize(Bytes&& blob_)
+    {
+        Bytes blob{std::move(blob_)};
+
+        if(blob.size() < Oid{}.size())//check
+        {
+            throw aup::Exception{"low data for deserialize plan"};
+        }
+
+        Oid check;
+        {
+            bytes::Alter a{blob.end()};
+            a.advance(-int32{check.size()});
+            a.removeTo(check.data(), check.size());
+        }
+
+        if(check != catalog::identify(blob))
+        {
+            throw aup::Exception{"corrupted data for deserialize plan"};
+        }
+
+        Plan plan;
+
+        try
+        {
+            stiac::serialization::Arch arch{blob.begin()};
+
+            uint64 magic;
+            arch >> magic;
+
+            if(g_magic != magic)
+            {
+                throw aup::Exception{"unknown magic for deserialize plan: "+std::to_string(magic)};
+            }
+
+            arch >> plan._place >> plan._task >> plan._result;
+
+            uint64 amount;
+            arch >> stiac::smallIntegral(amount);
+            for(uint64 i{}; i<amount; ++i)
+            {
+                Action a;
+                uint8 kind;
+                arch >> kind >> a._path >> a._content >> a._perms >> stiac::smallIntegral(a._size);
+
+                if(kind < static_cast<uint8>(Action::Kind::remove) || kind > static_cast<uint8>(Action::Kind::link))
+                {
+                    throw aup::Exception{"unknown action kind for deserialize plan: "+std::to_string(kind)};
+                }
+                a._kind = static_cast<Action::Kind>(kind);
+
+                plan._actions.push_back(std::move(a));
+            }
+
+            arch >> stiac::smallIntegral(amount);
+            for(uint64 i{}; i<amount; ++i)
+            {
+                std::string dir;
+                arch >> dir;
+                plan._dirs.push_back(std::move(dir));
+            }
+
+            arch >> stiac::smallIntegral(amount);
+            for(uint64 i{}; i<amount; ++i)
+            {
+                std::string pattern;
+                arch >> pattern;
+                plan._extraAllowed.insert(std::move(pattern));
+            }
+        }
+        catch(const aup::Exception&)
+        {
+            throw;
+        }
+        catch(...)
+        {
+            std::throw_with_nested(aup::Exception{"malformed data for deserialize plan"});
+        }
+
+        return plan;
+    }
+}
@@ -62,4 +62,10 @@ namespace dci::aup
     {
         return impl().del(oid);
     }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    const catalog::Object* Catalog::find(const Oid& oid) const
+    {
+        return impl().find(oid);
+    }
 }
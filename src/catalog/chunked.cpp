@@ -0,0 +1,122 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+
+#include <dci/aup/catalog/chunked.hpp>
+#include <algorithm>
+#include <array>
+
+namespace dci::aup::catalog
+{
+    /* FastCDC: gear-хэш по скользящему окну, граница - где нужные биты хэша нулевые
+     *
+     * первые g_min байт куска не проверяются, до g_normal маска строже, после - мягче (нормализация
+     * распределения размеров около g_normal), на g_max - принудительная граница
+     */
+    namespace
+    {
+        constexpr uint64 g_min      = 16 * 1024;
+        constexpr uint64 g_normal   = 64 * 1024;
+        constexpr uint64 g_max      = 256 * 1024;
+
+        constexpr uint64 g_maskStrict   = ~uint64{} << (64 - 18);
+        constexpr uint64 g_maskLoose    = ~uint64{} << (64 - 14);
+
+        //таблица фиксирована навсегда - от нее зависят границы, а значит и идентификаторы кусков
+        constexpr std::array<uint64, 256> g_gear = []
+        {
+            std::array<uint64, 256> res{};
+
+            uint64 state = 0x6a09e667f3bcc908;
+            for(uint64& v : res)
+            {
+                //splitmix64
+                uint64 z = (state += 0x9e3779b97f4a7c15);
+                z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+                z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+                v = z ^ (z >> 31);
+            }
+
+            return res;
+        }();
+
+        struct Chunker
+        {
+            std::vector<uint64> _sizes;
+            uint64              _size {};
+            uint64              _hash {};
+
+            /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+            void feed(const uint8* data, uint64 size)
+            {
+                const uint8* end = data + size;
+
+                while(data != end)
+                {
+                    //начало куска не хэшируется
+                    if(_size < g_min)
+                    {
+                        uint64 skip = std::min(g_min - _size, static_cast<uint64>(end - data));
+                        _size += skip;
+                        data += skip;
+                        continue;
+                    }
+
+                    _hash = (_hash << 1) + g_gear[*data++];
+                    ++_size;
+
+                    if(!(_hash & (_size < g_normal ? g_maskStrict : g_maskLoose)) || g_max == _size)
+                    {
+                        cut();
+                    }
+                }
+            }
+
+            /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+            void cut()
+            {
+                _sizes.push_back(_size);
+                _size = 0;
+                _hash = 0;
+            }
+
+            /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+            std::vector<uint64> finish()
+            {
+                if(_size)
+                {
+                    cut();
+                }
+
+                return std::move(_sizes);
+            }
+        };
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    std::vector<uint64> chunkSizes(const void* data, uint64 size)
+    {
+        Chunker c;
+        c.feed(static_cast<const uint8*>(data), size);
+        return c.finish();
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    std::vector<uint64> chunkSizes(const Bytes& blob)
+    {
+        Chunker c;
+
+        bytes::Cursor cursor{blob.begin()};
+        while(!cursor.atEnd())
+        {
+            c.feed(static_cast<const uint8*>(cursor.continuousData()), cursor.continuousDataSize());
+            cursor.advanceChunks(1);
+        }
+
+        return c.finish();
+    }
+}
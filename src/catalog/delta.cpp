@@ -0,0 +1,277 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+
+#include <dci/aup/catalog/delta.hpp>
+#include <dci/aup/exception.hpp>
+#include <unordered_map>
+#include <vector>
+#include <cstring>
+
+namespace dci::aup::catalog
+{
+    /* формат тела дельты
+     *
+     * varint baseSize, varint targetSize, далее операции до конца:
+     *  varint (size<<1)|1, size байт - вставка литерала
+     *  varint (size<<1)|0, varint offset - копирование size байт из base с offset
+     */
+    namespace
+    {
+        constexpr uint64 g_block = 32;
+        constexpr uint64 g_prime = 0x100000001b3;
+
+        /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+        uint64 blockHash(const uint8* data)
+        {
+            uint64 h = 0;
+            for(uint64 i{}; i<g_block; ++i)
+            {
+                h = h * g_prime + data[i];
+            }
+            return h;
+        }
+
+        /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+        void putVarint(std::vector<uint8>& dst, uint64 v)
+        {
+            while(v >= 0x80)
+            {
+                dst.push_back(static_cast<uint8>(v | 0x80));
+                v >>= 7;
+            }
+            dst.push_back(static_cast<uint8>(v));
+        }
+
+        /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+        uint64 getVarint(const uint8*& pos, const uint8* end)
+        {
+            uint64 v = 0;
+            for(uint32 shift{}; shift < 64; shift += 7)
+            {
+                if(pos == end)
+                {
+                    throw aup::Exception{"delta truncated"};
+                }
+
+                uint8 b = *pos++;
+                v |= uint64{b & 0x7fu} << shift;
+                if(!(b & 0x80))
+                {
+                    return v;
+                }
+            }
+
+            throw aup::Exception{"delta malformed"};
+        }
+
+        /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+        void putLiteral(std::vector<uint8>& dst, const uint8* data, uint64 size)
+        {
+            if(size)
+            {
+                putVarint(dst, (size << 1) | 1);
+                dst.insert(dst.end(), data, data + size);
+            }
+        }
+
+        /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+        std::vector<uint8> flat(const Bytes& blob)
+        {
+            std::vector<uint8> res;
+            res.reserve(blob.size());
+
+            bytes::Cursor c{blob.begin()};
+            while(!c.atEnd())
+            {
+                res.insert(res.end(), c.continuousData(), c.continuousData() + c.continuousDataSize());
+                c.advanceChunks(1);
+            }
+
+            return res;
+        }
+
+        /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+        Bytes toBytes(const std::vector<uint8>& data)
+        {
+            Bytes res;
+            bytes::Alter a{res.end()};
+
+            constexpr std::size_t chunk = std::size_t{1} << 30;
+            for(std::size_t pos{}; pos < data.size(); pos += chunk)
+            {
+                a.write(data.data() + pos, static_cast<uint32>(std::min(chunk, data.size() - pos)));
+            }
+
+            return res;
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    Bytes makeDelta(const void* base, uint64 baseSize, const void* target, uint64 targetSize)
+    {
+        const uint8* b = static_cast<const uint8*>(base);
+        const uint8* t = static_cast<const uint8*>(target);
+
+        //блоки base по границам g_block, при совпадении хэшей держится первый
+        std::unordered_map<uint64, uint64> blocks;
+        blocks.reserve(baseSize / g_block);
+        for(uint64 off{}; off + g_block <= baseSize; off += g_block)
+        {
+            blocks.emplace(blockHash(b + off), off);
+        }
+
+        uint64 highPower = 1;
+        for(uint64 i{1}; i<g_block; ++i)
+        {
+            highPower *= g_prime;
+        }
+
+        std::vector<uint8> res;
+        putVarint(res, baseSize);
+        putVarint(res, targetSize);
+
+        //скользящий хэш окна target, совпадения расширяются в обе стороны
+        uint64 literal = 0;
+        uint64 pos = 0;
+        uint64 h = targetSize >= g_block ? blockHash(t) : 0;
+
+        while(pos + g_block <= targetSize)
+        {
+            auto iter = blocks.find(h);
+            if(blocks.end() != iter && !std::memcmp(b + iter->second, t + pos, g_block))
+            {
+                uint64 from = iter->second;
+                uint64 start = pos;
+                while(start > literal && from > 0 && b[from-1] == t[start-1])
+                {
+                    --start;
+                    --from;
+                }
+
+                uint64 size = pos - start + g_block;
+                while(start + size < targetSize && from + size < baseSize && b[from + size] == t[start + size])
+                {
+                    ++size;
+                }
+
+                putLiteral(res, t + literal, start - literal);
+                putVarint(res, size << 1);
+                putVarint(res, from);
+
+                pos = literal = start + size;
+                if(pos + g_block <= targetSize)
+                {
+                    h = blockHash(t + pos);
+                }
+                continue;
+            }
+
+            if(pos + g_block < targetSize)
+            {
+                h = (h - t[pos] * highPower) * g_prime + t[pos + g_block];
+            }
+            ++pos;
+        }
+
+        putLiteral(res, t + literal, targetSize - literal);
+
+        return toBytes(res);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    Bytes makeDelta(const Bytes& base, const Bytes& target)
+    {
+        std::vector<uint8> b = flat(base);
+        std::vector<uint8> t = flat(target);
+        return makeDelta(b.data(), b.size(), t.data(), t.size());
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void applyDelta(const void* base, uint64 baseSize, const void* delta, uint64 deltaSize, const std::function<void(const uint8*, uint64)>& sink)
+    {
+        const uint8* b = static_cast<const uint8*>(base);
+        const uint8* pos = static_cast<const uint8*>(delta);
+        const uint8* end = pos + deltaSize;
+
+        if(getVarint(pos, end) != baseSize)
+        {
+            throw aup::Exception{"delta base size mismatch"};
+        }
+
+        uint64 targetSize = getVarint(pos, end);
+
+        //куски отдаются прямо из base и тела дельты, без промежуточного буфера
+        uint64 written = 0;
+        while(pos != end)
+        {
+            uint64 op = getVarint(pos, end);
+            uint64 size = op >> 1;
+
+            if(size > targetSize - written)
+            {
+                throw aup::Exception{"delta target overflow"};
+            }
+
+            if(op & 1)
+            {
+                if(size > static_cast<uint64>(end - pos))
+                {
+                    throw aup::Exception{"delta truncated"};
+                }
+
+                if(size) sink(pos, size);
+                pos += size;
+            }
+            else
+            {
+                uint64 from = getVarint(pos, end);
+                if(from > baseSize || size > baseSize - from)
+                {
+                    throw aup::Exception{"delta base overflow"};
+                }
+
+                if(size) sink(b + from, size);
+            }
+
+            written += size;
+        }
+
+        if(written != targetSize)
+        {
+            throw aup::Exception{"delta target size mismatch"};
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    Bytes applyDelta(const void* base, uint64 baseSize, const Bytes& delta)
+    {
+        std::vector<uint8> d = flat(delta);
+
+        Bytes res;
+        {
+            bytes::Alter a{res.end()};
+            applyDelta(base, baseSize, d.data(), d.size(), [&](const uint8* data, uint64 size)
+            {
+                constexpr uint64 chunk = uint64{1} << 30;
+                for(uint64 pos{}; pos < size; pos += chunk)
+                {
+                    a.write(data + pos, static_cast<uint32>(std::min(chunk, size - pos)));
+                }
+            });
+        }
+
+        return res;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    Bytes applyDelta(const Bytes& base, const Bytes& delta)
+    {
+        std::vector<uint8> b = flat(base);
+        return applyDelta(b.data(), b.size(), delta);
+    }
+}
@@ -15,12 +15,17 @@
 #include <dci/stiac/serialization.hpp>
 
 #include "../impl/catalog/enumerateObjectFields.hpp"
+#include <memory>
+#include <cstring>
 
 namespace dci::aup::catalog
 {
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     namespace
     {
+        //blake3 обрабатывает пачкой (SIMD) только блоки по 1 KiB, пришедшие в одном add - хэшу подаются крупные порции
+        constexpr uint32 g_portionSize = 1024 * 1024;
+
         struct OidMaker
         {
             crypto::Blake3 _hashier{32};
@@ -47,10 +52,54 @@ namespace dci::aup::catalog
 
         bytes::Cursor c{blob.begin()};
 
-        while(!c.atEnd())
+        if(blob.size() <= g_portionSize)
         {
-            arch.write(c.continuousData(), c.continuousDataSize());
-            c.advanceChunks(1);
+            while(!c.atEnd())
+            {
+                arch.write(c.continuousData(), c.continuousDataSize());
+                c.advanceChunks(1);
+            }
+        }
+        else
+        {
+            //мелкие куски собираются в порции, крупные подаются как есть
+            std::unique_ptr<uint8[]> portion{new uint8[g_portionSize]};
+            uint32 portionSize{};
+
+            while(!c.atEnd())
+            {
+                const uint8* data = static_cast<const uint8*>(c.continuousData());
+                uint32 size = c.continuousDataSize();
+
+                if(size >= g_portionSize / 4)
+                {
+                    if(portionSize)
+                    {
+                        arch.write(portion.get(), portionSize);
+                        portionSize = 0;
+                    }
+
+                    arch.write(data, size);
+                }
+                else
+                {
+                    if(portionSize + size > g_portionSize)
+                    {
+                        arch.write(portion.get(), portionSize);
+                        portionSize = 0;
+                    }
+
+                    std::memcpy(portion.get() + portionSize, data, size);
+                    portionSize += size;
+                }
+
+                c.advanceChunks(1);
+            }
+
+            if(portionSize)
+            {
+                arch.write(portion.get(), portionSize);
+            }
         }
 
         Oid res;
@@ -66,19 +115,22 @@ namespace dci::aup::catalog
         OidMaker arch;
 
         rewind(f);
-        char buf[1024];
+
+        //крупный буфер: меньше системных вызовов (fread такого размера читает мимо буфера потока) и пачки для хэша;
+        //без mmap - усечение файла извне под отображением обернулось бы SIGBUS
+        std::unique_ptr<char[]> buf{new char[g_portionSize]};
 
         for(;;)
         {
-            std::size_t s = fread(buf, 1, sizeof(buf), f);
+            std::size_t s = fread(buf.get(), 1, g_portionSize, f);
             if(!s)
             {
                 break;
             }
 
-            arch.write(buf, static_cast<uint32>(s));
+            arch.write(buf.get(), static_cast<uint32>(s));
 
-            if(s != sizeof(buf))
+            if(s != g_portionSize)
             {
                 break;
             }
@@ -91,6 +143,27 @@ namespace dci::aup::catalog
         return res;
     }
 
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    Oid identify(const void* data, uint64 size)
+    {
+        OidMaker arch;
+
+        const uint8* cur = static_cast<const uint8*>(data);
+        while(size)
+        {
+            uint32 s = size > (uint32{1} << 30) ? (uint32{1} << 30) : static_cast<uint32>(size);
+            arch.write(cur, s);
+            cur += s;
+            size -= s;
+        }
+
+        Oid res;
+        dbgAssert(res.size() == arch._hashier.digestSize());
+        arch._hashier.finish(res.data());
+
+        return res;
+    }
+
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     Oid identify(const aup::catalog::Object* object)
     {
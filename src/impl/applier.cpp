@@ -8,13 +8,22 @@
 #include "applier.hpp"
 #include "catalog.hpp"
 #include "storage.hpp"
+#include "parallel.hpp"
+#include "copyRange.hpp"
+#include "exchangePaths.hpp"
+#include "storage/compressed.hpp"
 #include <dci/aup/catalog/identify.hpp>
+#include <dci/aup/exception.hpp>
 #include <dci/utils/atScopeExit.hpp>
 #include <dci/utils/b2h.hpp>
-#include <dci/utils/fnmatch.hpp>
 #include <dci/crypto/rnd.hpp>
 #include <dci/logger.hpp>
-#include <fstream>
+#include <algorithm>
+#include <exception>
+
+#ifdef __linux__
+#   include <sys/stat.h>
+#endif
 
 #define VERBOSE(msg) LOGI("applier: "<<msg)
 
@@ -23,6 +32,29 @@ namespace dci::aup::impl
     using namespace aup::catalog;
     using namespace aup::applier;
 
+    namespace
+    {
+        //биты задачи, от которых зависит оставленное на месте
+        constexpr uint64 g_keepingTask = tRemoveWrongs | tEmplaceMissings | tEmplaceChanges | tRemoveExtra;
+
+        void checkPlanPath(const std::string& path)
+        {
+            fs::path p{path};
+            if(p.empty() || p.has_root_path())
+            {
+                throw aup::Exception{"bad plan path: "+path};
+            }
+
+            for(const fs::path& part : p)
+            {
+                if(".." == part)
+                {
+                    throw aup::Exception{"bad plan path: "+path};
+                }
+            }
+        }
+    }
+
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     Applier::Applier()
     {
@@ -55,34 +87,380 @@ namespace dci::aup::impl
         }
     }
 
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Applier::setStatCache(Storage* s, const std::string& localPath, std::chrono::nanoseconds racyWindow)
+    {
+        _statCacheStorage = s;
+        _statCacheLocalPath = localPath;
+        _statCacheRacyWindow = racyWindow;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Applier::setDirty(std::optional<std::set<std::string>>&& dirty)
+    {
+        _dirty = std::move(dirty);
+    }
+
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     applier::Result Applier::process(const std::string &place, applier::Task task)
     {
+        applier::Plan p = plan(place, task);
+        if(p._result & rSomeFailed)
+        {
+            return static_cast<Result>(p._result);
+        }
+
+        return static_cast<Result>(p._result | execute(p));
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    applier::Plan Applier::plan(const std::string& place, applier::Task task)
+    {
+        int exceptions = std::uncaught_exceptions();
         utils::AtScopeExit fin = {[&]
         {
+            if(std::uncaught_exceptions() > exceptions)
+            {
+                dropStatCache();
+            }
             reset();
-            _place.clear();
-            _task = 0;
-            _points.clear();
-            _extraAllowed.clear();
         }};
 
         reset();
+        _plannedStatCache.clear();
+        _plannedPlace.reset();
+
         _place = fs::weakly_canonical(place);
         _task = task;
 
+        applier::Plan res;
+        res._place = _place.string();
+        res._task = task;
+
         for(const auto&[oid, fks] : _roots)
         {
-            uint64 res = traverse(oid, fks);
-            if(res)
+            res._result = traverse(oid, fks);
+            if(res._result)
             {
-                return static_cast<applier::Result>(res);
+                return res;
             }
         }
 
-        traverse(_place);
+        _extraAllowedMatcher.compile(_extraAllowed);
+
+        loadStatCache();
+
+        //выборочно - если известно измененное, а кэш построен при тех же задаче и допущенном лишнем;
+        //оставленное прошлым разом лишнее и неверное видно только полному обходу
+        if(_dirty && !(_task & (tShadow | tParanoid)) &&
+           !_statCache.entries().empty() &&
+           _statCache.extraAllowed() == _extraAllowed &&
+           _statCache.task() == (_task & g_keepingTask) &&
+           _statCache.kept().empty())
+        {
+            traverseDirty();
+        }
+        else
+        {
+            traverse(_place);
+        }
+
+        res._result = synchronize(res);
+        if(!(res._result & rSomeFailed))
+        {
+            //подтвержденное при построении плана, в том числе взятое из кэша без проверки
+            _statCache.clear();
+            _statCache.setExtraAllowed(_extraAllowed);
+            _statCache.setTask(_task & g_keepingTask);
+
+            std::set<std::string> kept;
+            for(const auto&[path, point] : _points)
+            {
+                if(point._ideal && point._realStat && point._realContent == point._ideal->_content)
+                {
+                    _statCache.put(relative(path), *point._realStat, *point._realContent);
+                }
+
+                bool keptWrong = point._realWrong && !(_task & tRemoveWrongs);
+                bool keptExtra = point._realFile && !point._ideal && !(_task & tRemoveExtra) && !extraAllowed(path);
+                if(keptWrong || keptExtra)
+                {
+                    kept.insert(relative(path));
+                }
+            }
+            _statCache.setKept(std::move(kept));
 
-        return static_cast<Result>(synchronize());
+            //место не менялось - сохранять нечего до исполнения
+            _plannedStatCache.swap(_statCache);
+            _plannedPlace = _place;
+        }
+
+        return res;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    applier::Result Applier::execute(const applier::Plan& plan)
+    {
+        int exceptions = std::uncaught_exceptions();
+        utils::AtScopeExit fin = {[&]
+        {
+            if(std::uncaught_exceptions() > exceptions)
+            {
+                //прерванное исполнение оставило место в неизвестном состоянии
+                dropStatCache();
+            }
+            reset();
+        }};
+
+        reset();
+
+        //план мог прийти извне, за пределы места он не пишет
+        for(const Action& action : plan._actions)
+        {
+            checkPlanPath(action._path);
+        }
+        for(const std::string& dir : plan._dirs)
+        {
+            checkPlanPath(dir);
+        }
+
+        _place = plan._place;
+        _task = plan._task;
+        _extraAllowed.insert(plan._extraAllowed.begin(), plan._extraAllowed.end());
+        _extraAllowedMatcher.compile(_extraAllowed);
+
+        //подтвержденное при построении этого плана, иначе - последнее сохраненное
+        bool planned = _plannedPlace && *_plannedPlace == _place;
+        if(planned)
+        {
+            _statCache.swap(_plannedStatCache);
+        }
+        else
+        {
+            loadStatCache();
+        }
+        _plannedStatCache.clear();
+        _plannedPlace.reset();
+
+        //в теневом режиме все пишется в соседнее дерево, место подменяется им в конце
+        bool shadow = (_task & tShadow) && std::any_of(plan._actions.begin(), plan._actions.end(), [](const Action& a)
+        {
+            //одни переносы - место и так в порядке
+            return Action::Kind::link != a._kind;
+        });
+        fs::path root = shadow ? sibling(".aup-shadow") : _place;
+        if(shadow)
+        {
+            fs::remove_all(root);
+            fs::create_directories(root);
+        }
+
+        uint64 res = rOk;
+
+        //результаты и состояния записанных файлов, по индексу действия
+        std::vector<uint64> results(plan._actions.size());
+        std::vector<std::optional<StatCache::Stat>> stats(plan._actions.size());
+        std::vector<std::size_t> mutations;
+
+        for(std::size_t index{}; index<plan._actions.size(); ++index)
+        {
+            const Action& action = plan._actions[index];
+            fs::path path = root / action._path;
+
+            switch(action._kind)
+            {
+            case Action::Kind::remove:
+                if(!shadow)
+                {
+                    res |= remove(path);
+                }
+                break;
+
+            case Action::Kind::link:
+                if(shadow)
+                {
+                    link(_place / action._path, path);
+                    if(Oid{} != action._content)
+                    {
+                        stats[index] = StatCache::take(path);
+                    }
+                }
+                break;
+
+            case Action::Kind::emplace:
+            case Action::Kind::update:
+                if(_task & tParallel)
+                {
+                    //отложено до пула
+                    mutations.push_back(index);
+                }
+                else
+                {
+                    res |= mutate(root, action, stats[index]);
+                }
+                break;
+
+            case Action::Kind::chmod:
+                if(shadow)
+                {
+                    //не ссылкой, права общие с прежним деревом
+                    fs::path origin = _place / action._path;
+                    fs::create_directories(path.parent_path());
+                    copyRange(origin, 0, fs::file_size(origin), path);
+                }
+                fs::permissions(path, static_cast<fs::perms>(action._perms));
+
+                //ctime изменилось
+                stats[index] = StatCache::take(path);
+                break;
+
+            default:
+                throw aup::Exception{"bad plan action"};
+            }
+        }
+
+        if(!mutations.empty())
+        {
+            //каталоги создаются заранее и последовательно, потоки пишут только файлы
+            std::set<fs::path> dirs;
+            for(std::size_t index : mutations)
+            {
+                dirs.insert((root / plan._actions[index]._path).parent_path());
+            }
+
+            for(const fs::path& dir : dirs)
+            {
+                fs::create_directories(dir);
+            }
+
+            parallelFor(mutations.size(), [&](std::size_t i)
+            {
+                std::size_t index = mutations[i];
+                results[index] = mutate(root, plan._actions[index], stats[index]);
+            });
+
+            for(uint64 r : results)
+            {
+                res |= r;
+            }
+        }
+
+        if(shadow)
+        {
+            //в теневом дереве только нужное, уборка не требуется; из опустевших каталогов
+            //переносятся те, что уборка на месте оставила бы
+            for(const std::string& dir : plan._dirs)
+            {
+                fs::path origin = _place / dir;
+                if(fs::exists(root / dir) || !fs::is_directory(fs::symlink_status(origin)))
+                {
+                    continue;
+                }
+
+                if(!(_task & tRemoveExtra) || extraAllowed(origin))
+                {
+                    fs::create_directories(root / dir);
+                    fs::permissions(root / dir, fs::status(origin).permissions());
+                }
+            }
+
+            switchTo(root);
+        }
+        else
+        {
+            //remove empty directories
+            for(const std::string& dir : plan._dirs)
+            {
+                _emptyDirCandidates.insert(_place / dir);
+            }
+        }
+
+        while(!_emptyDirCandidates.empty())
+        {
+            std::set<fs::path> tmp;
+            tmp.swap(_emptyDirCandidates);
+
+            for(const fs::path& path : tmp)
+            {
+                fs::path rp = path.lexically_relative(_place);
+                if(rp.empty() || ".." == *rp.begin())
+                {
+                    continue;
+                }
+
+                if(fs::is_directory(path) && fs::is_empty(path))
+                {
+                    if(extraAllowed(path))
+                    {
+                        //if(_task & tVerboseMinor) VERBOSE("empty dir allowed "<<path.lexically_proximate(_place));
+                    }
+                    else
+                    {
+                        if(_task & tRemoveExtra)
+                        {
+                            if(_task & tVerboseMajor) VERBOSE("remove empty dir "<<path.lexically_proximate(_place));
+                            res |= remove(path);
+                            _emptyDirCandidates.insert(path.parent_path());
+                        }
+                        else
+                        {
+                            if(_task & tVerboseMinor) VERBOSE("empty dir "<<path.lexically_proximate(_place));
+                        }
+                    }
+                }
+            }
+        }
+
+        //записанное дополняет кэш состояния
+        if(!(res & rSomeFailed))
+        {
+            bool changed = planned;
+            for(std::size_t index{}; index<plan._actions.size(); ++index)
+            {
+                if(stats[index])
+                {
+                    _statCache.put(plan._actions[index]._path, *stats[index], plan._actions[index]._content);
+                    changed = true;
+                }
+            }
+
+            if(changed)
+            {
+                saveStatCache();
+            }
+        }
+
+        return static_cast<Result>(res);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    bool Applier::rollback(const std::string& place)
+    {
+        utils::AtScopeExit fin = {[&]
+        {
+            reset();
+        }};
+
+        reset();
+        _place = fs::weakly_canonical(place);
+
+        fs::path previous = sibling(".aup-previous");
+        if(!fs::is_directory(previous))
+        {
+            return false;
+        }
+
+        //откат - тот же обмен, повторный откат возвращает новое дерево
+        if(!exchangePaths(previous, _place))
+        {
+            fs::path tmp = sibling(".aup-rollback");
+            fs::remove_all(tmp);
+            fs::rename(_place, tmp);
+            fs::rename(previous, _place);
+            fs::rename(tmp, previous);
+        }
+
+        return true;
     }
 
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
@@ -90,53 +468,56 @@ namespace dci::aup::impl
     {
         _place.clear();
         _task = 0;
+        _traversedOids.clear();
         _traversed.clear();
         _points.clear();
         _extraAllowed.clear();
+        _extraAllowedMatcher.clear();
         _emptyDirCandidates.clear();
+        _statCache.clear();
     }
 
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     uint64 Applier::traverse(const Oid& oid, const Set<File::Kind>& fileKinds)
     {
-        if(!_traversed.insert(oid).second)
+        if(!_traversed.insert(_traversedOids.intern(oid)))
         {
             //already
             return rOk;
         }
 
-        ObjectPtr o = fetchObject(oid);
+        const Object* o = fetchObject(oid);
         if(!o)
         {
             LOGE("catalog object incomplete: "<<utils::b2h(oid));
             return rIncompleteCatalog;
         }
 
-        Set<Oid> dependencies;
+        const Set<Oid>* dependencies = nullptr;
         switch(o->type())
         {
         case Object::Type::release:
-            dependencies = o->_dependencies;
+            dependencies = &o->_dependencies;
             break;
 
         case Object::Type::unit:
             {
-                UnitPtr u = objectPtrCast<Unit>(std::move(o));
+                const Unit* u = objectPtrCast<Unit>(o);
                 _extraAllowed.insert(u->_extraAllowed.begin(), u->_extraAllowed.end());
-                dependencies = u->_dependencies;
+                dependencies = &u->_dependencies;
             }
             break;
 
         case Object::Type::file:
             {
-                FilePtr f = objectPtrCast<File>(std::move(o));
+                const File* f = objectPtrCast<File>(o);
 
                 if(!fileKinds.count(f->_kind))
                 {
                     break;
                 }
 
-                dependencies = f->_dependencies;
+                dependencies = &f->_dependencies;
 
                 {
                     fs::path dir = _place/f->_path;
@@ -151,7 +532,7 @@ namespace dci::aup::impl
 
                 if(!point._ideal)
                 {
-                    point._ideal = std::move(f);
+                    point._ideal = f;
                     point._idealOid = oid;
                 }
                 else
@@ -183,17 +564,25 @@ namespace dci::aup::impl
             }
             break;
 
+        case Object::Type::delta:
+        case Object::Type::chunked:
+            //содержимое файла восстанавливается из дельт и кусков в Instance, здесь нужно только наличие
+            break;
+
         default:
             LOGE("catalog corrupted");
             return rCorruptedCatalog;
         }
 
-        for(const Oid& dep : dependencies)
+        if(dependencies)
         {
-            uint64 res = traverse(dep, fileKinds);
-            if(res)
+            for(const Oid& dep : *dependencies)
             {
-                return static_cast<applier::Result>(res);
+                uint64 res = traverse(dep, fileKinds);
+                if(res)
+                {
+                    return static_cast<applier::Result>(res);
+                }
             }
         }
 
@@ -208,57 +597,152 @@ namespace dci::aup::impl
             return;
         }
 
-        for(auto entry : fs::recursive_directory_iterator(dir))
+        //тип, права, размер и состояние - за один системный вызов на файл
+        scanTree(dir, [&](fs::path&& path, const ScanEntry& entry)
         {
-            Point& point = _points[entry.path()];
+            record(std::move(path), entry);
+        });
+    }
 
-            if(entry.is_regular_file())
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Applier::traverseDirty()
+    {
+        //путь или один из его каталогов изменялся
+        auto dirty = [&](const std::string& rel)
+        {
+            for(std::size_t pos = rel.find('/'); std::string::npos != pos; pos = rel.find('/', pos+1))
             {
-                if(point._requiredAsDirectory)
+                if(_dirty->count(rel.substr(0, pos)))
                 {
-                    point._realWrong = true;
-                }
-                else
-                {
-                    point._realFile = true;
-                    point._realPerms = entry.status().permissions();
-                    point._realSize = entry.file_size();
-                    //point._realContent;
+                    return true;
                 }
+            }
 
-                _emptyDirCandidates.insert(entry.path().parent_path());
+            return _dirty->count(rel) > 0;
+        };
+
+        for(const std::string& rel : *_dirty)
+        {
+            std::size_t pos = rel.rfind('/');
+            if(std::string::npos == pos || !dirty(rel.substr(0, pos)))
+            {
+                traverseOne(_place / rel);
             }
-            else if(entry.is_directory())
+        }
+
+        //нетронутое с прошлого раза известно по кэшу
+        for(const auto&[rel, e] : _statCache.entries())
+        {
+            if(dirty(rel))
             {
-                if(point._ideal)
-                {
-                    point._realWrong = true;
-                }
-                _emptyDirCandidates.insert(entry.path());
+                continue;
+            }
+
+            if(e._racy)
+            {
+                traverseOne(_place / rel);
+                continue;
+            }
+
+            Point& point = _points[_place / rel];
+            if(point._requiredAsDirectory)
+            {
+                traverseOne(_place / rel);
+                continue;
+            }
+
+            point._realFile = true;
+            point._realPerms = static_cast<fs::perms>(e._stat._mode);
+            point._realSize = e._stat._size;
+            point._realStat = e._stat;
+            point._realContent = e._content;
+        }
+
+        //новое в каталоге, о прошлом состоянии которого ничего не известно
+        for(auto&[path, point] : _points)
+        {
+            if(point._ideal && !point._realFile && !point._realWrong && !dirty(relative(path)))
+            {
+                traverseOne(path);
+            }
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Applier::traverseOne(const fs::path& path)
+    {
+        bool descend;
+        std::optional<ScanEntry> entry = scanOne(path, descend);
+        if(!entry)
+        {
+            //удаленное могло оставить каталог пустым
+            _emptyDirCandidates.insert(path.parent_path());
+            return;
+        }
+
+        record(fs::path{path}, *entry);
+
+        if(descend)
+        {
+            traverse(path);
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Applier::record(fs::path&& path, const ScanEntry& entry)
+    {
+        auto [iter, inserted] = _points.try_emplace(std::move(path));
+        (void)inserted;
+        const fs::path& key = iter->first;
+        Point& point = iter->second;
+
+        switch(entry._kind)
+        {
+        case ScanEntry::Kind::file:
+            if(point._requiredAsDirectory)
+            {
+                point._realWrong = true;
             }
             else
+            {
+                point._realFile = true;
+                point._realPerms = entry._perms;
+                point._realSize = entry._size;
+                point._realStat = entry._stat;
+                //point._realContent;
+            }
+
+            _emptyDirCandidates.insert(key.parent_path());
+            break;
+
+        case ScanEntry::Kind::directory:
+            if(point._ideal)
             {
                 point._realWrong = true;
-                _emptyDirCandidates.insert(entry.path().parent_path());
             }
+            _emptyDirCandidates.insert(key);
+            break;
+
+        default:
+            point._realWrong = true;
+            _emptyDirCandidates.insert(key.parent_path());
+            break;
         }
     }
 
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
-    ObjectPtr Applier::fetchObject(const Oid& oid)
+    const Object* Applier::fetchObject(const Oid& oid)
     {
-        ObjectPtr res;
-
         for(Catalog* c : _catalogs)
         {
-            res = c->get(oid);
+            const Object* res = c->find(oid);
             if(res)
             {
                 return res;
             }
         }
 
-        return res;
+        return nullptr;
     }
 
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
@@ -276,13 +760,35 @@ namespace dci::aup::impl
     }
 
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
-    std::optional<Bytes> Applier::fetchContent(const Oid& oid)
+    std::optional<aup::storage::Mapping> Applier::mapContent(const Oid& oid)
     {
-        std::optional<Bytes> res;
+        //хранилища не потокобезопасны, под блокировкой только отображение, копирование - без нее
+        std::lock_guard lock{_storagesMtx};
+
+        std::optional<aup::storage::Mapping> res;
 
         for(Storage* s : _storages)
         {
-            res = s->get(oid);
+            res = s->map(oid);
+            if(res)
+            {
+                return res;
+            }
+        }
+
+        return res;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    std::optional<Storage::Placement> Applier::placeContent(const Oid& oid)
+    {
+        std::lock_guard lock{_storagesMtx};
+
+        std::optional<Storage::Placement> res;
+
+        for(Storage* s : _storages)
+        {
+            res = s->placement(oid);
             if(res)
             {
                 return res;
@@ -304,42 +810,134 @@ namespace dci::aup::impl
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     Oid Applier::evaluateContentCheck(const fs::path& p)
     {
-        std::ifstream in{p.native().c_str(), std::ios_base::in | std::ios_base::binary};
-
+        //потоково, без накопления файла в памяти
+        std::FILE* in = fopen(p.string().c_str(), "rb");
         if(!in)
         {
             throw std::system_error(errno, std::generic_category(), "unable to open "+p.string());
         }
 
-        dci::Bytes blob;
-        dci::bytes::Alter a {blob.end()};
-        for(;;)
+        utils::AtScopeExit closer{[&]
         {
-            uint32 bufSize;
-            void* buf = a.prepareWriteBuffer(bufSize);
-            if(!in.read(static_cast<char *>(buf), bufSize))
+            fclose(in);
+        }};
+
+        Oid res = dci::aup::catalog::identify(in);
+
+        if(ferror(in))
+        {
+            throw std::system_error(errno, std::generic_category(), "unable to read "+p.string());
+        }
+
+        return res;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Applier::evaluateContentChecks()
+    {
+        //только совпавшие по размеру, остальные и так будут обновлены
+        std::vector<std::pair<const fs::path*, Point*>> candidates;
+        for(auto&[path, point] : _points)
+        {
+            if(point._realFile && point._ideal && point._realSize == point._ideal->_size && !point._realContent)
             {
-                if(in.eof())
-                {
-                    bufSize = static_cast<uint32>(in.gcount());
-                    a.commitWriteBuffer(bufSize);
-                    break;
-                }
-                else
+                candidates.emplace_back(&path, &point);
+            }
+        }
+
+        //каждый поток держит не более одного открытого файла
+        parallelFor(candidates.size(), [&](std::size_t index)
+        {
+            auto [path, point] = candidates[index];
+
+            if(!point->_realStat)
+            {
+                point->_realStat = StatCache::take(*path);
+            }
+
+            if(point->_realStat && !(_task & tParanoid))
+            {
+                const Oid* cached = _statCache.find(relative(*path), *point->_realStat);
+                if(cached)
                 {
-                    throw std::system_error(errno, std::generic_category(), "unable to read "+p.string());
+                    point->_realContent = *cached;
+                    return;
                 }
             }
 
-            bufSize = static_cast<uint32>(in.gcount());
-            a.commitWriteBuffer(bufSize);
+            point->_realContent = evaluateContentCheck(*path);
+        });
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Applier::loadStatCache()
+    {
+        _statCache.clear();
+
+        if(!_statCacheStorage)
+        {
+            return;
         }
 
-        return dci::aup::catalog::identify(blob);
+        try
+        {
+            std::optional<Bytes> blob = _statCacheStorage->get(_statCacheLocalPath);
+            if(blob)
+            {
+                _statCache.deserialize(std::move(*blob), _place.string(), _statCacheRacyWindow);
+            }
+        }
+        catch(...)
+        {
+            //кэш необязателен, без него содержимое пересчитывается
+            LOGW("stat cache dropped: "<<dci::exception::toString(std::current_exception()));
+            _statCache.clear();
+        }
     }
 
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
-    uint64 Applier::synchronize()
+    void Applier::saveStatCache()
+    {
+        if(!_statCacheStorage)
+        {
+            return;
+        }
+
+        try
+        {
+            _statCacheStorage->put(_statCacheLocalPath, _statCache.serialize(_place.string(), _statCacheRacyWindow));
+        }
+        catch(...)
+        {
+            LOGW("unable to save stat cache: "<<dci::exception::toString(std::current_exception()));
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Applier::dropStatCache()
+    {
+        //вызывается при раскрутке исключения - не бросает
+        _plannedStatCache.clear();
+        _plannedPlace.reset();
+
+        if(!_statCacheStorage)
+        {
+            return;
+        }
+
+        try
+        {
+            //без кэша следующее применение проверяет место целиком, даже если измененное известно
+            _statCacheStorage->del(_statCacheLocalPath);
+        }
+        catch(...)
+        {
+            LOGW("unable to drop stat cache: "<<dci::exception::toString(std::current_exception()));
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    uint64 Applier::synchronize(applier::Plan& plan)
     {
         uint64 res = 0;
 
@@ -349,13 +947,13 @@ namespace dci::aup::impl
             {
                 if(_task & tCheckStorage)
                 {
-                    auto blob = fetchContent(point._ideal->_content);
-                    if(!blob)
+                    auto mapping = mapContent(point._ideal->_content);
+                    if(!mapping)
                     {
                         if(_task & tVerboseMajor) VERBOSE("storage missing "<<path.lexically_proximate(_place));
                         res |= rIncompleteStorage;
                     }
-                    else if(point._ideal->_content != dci::aup::catalog::identify(*blob))
+                    else if(point._ideal->_content != dci::aup::catalog::identify(mapping->data(), mapping->size()))
                     {
                         if(_task & tVerboseMajor) VERBOSE("storage corrupted "<<path.lexically_proximate(_place));
                         deleteContent(point._ideal->_content);
@@ -378,6 +976,9 @@ namespace dci::aup::impl
             return res;
         }
 
+        //до изменений, результаты сводятся в точки
+        evaluateContentChecks();
+
         for(auto&[path, point] : _points)
         {
             if(point._realWrong || (point._requiredAsDirectory && point._ideal))
@@ -385,11 +986,15 @@ namespace dci::aup::impl
                 if(_task & tRemoveWrongs)
                 {
                     if(_task & tVerboseMajor) VERBOSE("remove wrong "<<path.lexically_proximate(_place));
-                    res |= remove(path);
+                    plan._actions.push_back(Action{Action::Kind::remove, relative(path)});
                 }
                 else
                 {
                     if(_task & tVerboseMinor) VERBOSE("wrong "<<path.lexically_proximate(_place));
+                    if(point._realWrong)
+                    {
+                        carry(plan, path, nullptr);
+                    }
                 }
             }
         }
@@ -402,18 +1007,20 @@ namespace dci::aup::impl
                 if(extraAllowed(path))
                 {
                     //if(_task & tVerboseMinor) VERBOSE("extra allowed "<<path.lexically_proximate(_place));
+                    carry(plan, path, nullptr);
                 }
                 else
                 {
                     if(_task & tRemoveExtra)
                     {
                         if(_task & tVerboseMajor) VERBOSE("remove extra "<<path.lexically_proximate(_place));
-                        res |= remove(path);
+                        plan._actions.push_back(Action{Action::Kind::remove, relative(path)});
                     }
                     else
                     {
                         if(_task & tVerboseMinor) VERBOSE("extra "<<path.lexically_proximate(_place));
                         res |= rExistsExtra;
+                        carry(plan, path, nullptr);
                     }
                 }
             }
@@ -429,7 +1036,7 @@ namespace dci::aup::impl
                 if(_task & tEmplaceMissings)
                 {
                     if(_task & tVerboseMajor) VERBOSE("emplace missing "<<path.lexically_proximate(_place));
-                    res |= emplace(path, permsFor(point._ideal.get()), point._ideal->_content);
+                    plan._actions.push_back(action(Action::Kind::emplace, path, point));
                 }
                 else
                 {
@@ -444,83 +1051,65 @@ namespace dci::aup::impl
                     if(_task & tEmplaceChanges)
                     {
                         if(_task & tVerboseMajor) VERBOSE("wrong size, update "<<path.lexically_proximate(_place));
-                        res |= update(path, permsFor(point._ideal.get()), point._ideal->_content);
+                        plan._actions.push_back(action(Action::Kind::update, path, point));
                     }
                     else
                     {
                         if(_task & tVerboseMinor) VERBOSE("wrong size "<<path.lexically_proximate(_place));
                         res |= rExistsChanges;
+                        carry(plan, path, nullptr);
                     }
                 }
-                else if(evaluateContentCheck(path) != point._ideal->_content)
+                else if(point._realContent != point._ideal->_content)
                 {
                     if(_task & tEmplaceChanges)
                     {
                         if(_task & tVerboseMajor) VERBOSE("wrong content, update "<<path.lexically_proximate(_place));
-                        res |= update(path, permsFor(point._ideal.get()), point._ideal->_content);
+                        plan._actions.push_back(action(Action::Kind::update, path, point));
                     }
                     else
                     {
                         if(_task & tVerboseMinor) VERBOSE("wrong content "<<path.lexically_proximate(_place));
                         res |= rExistsChanges;
+                        carry(plan, path, nullptr);
                     }
                 }
-                else if(point._realPerms != permsFor(point._ideal.get()))
+                else if(point._realPerms != permsFor(point._ideal))
                 {
                     if(_task & tEmplaceChanges)
                     {
                         if(_task & tVerboseMajor) VERBOSE("wrong permissions, fix "<<path.lexically_proximate(_place));
-                        fs::permissions(path, permsFor(point._ideal.get()));
+                        Action a = action(Action::Kind::chmod, path, point);
+                        a._size = 0;
+                        plan._actions.push_back(std::move(a));
                     }
                     else
                     {
                         if(_task & tVerboseMinor) VERBOSE("wrong permissions "<<path.lexically_proximate(_place));
                         res |= rExistsChanges;
+                        carry(plan, path, &point._ideal->_content);
                     }
                 }
                 else
                 {
                     //all equal
+                    carry(plan, path, &point._ideal->_content);
                 }
             }
         }
 
-        //remove empty directories
-        while(!_emptyDirCandidates.empty())
+        //уборка опустевших каталогов - после исполнения
+        for(const fs::path& dir : _emptyDirCandidates)
         {
-            std::set<fs::path> tmp;
-            tmp.swap(_emptyDirCandidates);
-
-            for(const fs::path& path : tmp)
+            fs::path rp = dir.lexically_relative(_place);
+            if(!rp.empty() && ".." != *rp.begin())
             {
-                fs::path rp = path.lexically_relative(_place);
-                if(rp.empty() || ".." == *rp.begin())
-                {
-                    continue;
-                }
-
-                if(fs::is_directory(path) && fs::is_empty(path))
-                {
-                    if(extraAllowed(path))
-                    {
-                        //if(_task & tVerboseMinor) VERBOSE("empty dir allowed "<<path.lexically_proximate(_place));
-                    }
-                    else
-                    {
-                        if(_task & tRemoveExtra)
-                        {
-                            if(_task & tVerboseMajor) VERBOSE("remove empty dir "<<path.lexically_proximate(_place));
-                            res |= remove(path);
-                            _emptyDirCandidates.insert(path.parent_path());
-                        }
-                        else
-                        {
-                            if(_task & tVerboseMinor) VERBOSE("empty dir "<<path.lexically_proximate(_place));
-                        }
-                    }
-                }
+                plan._dirs.push_back(rp.generic_string());
             }
         }
+        _emptyDirCandidates.clear();
+
+        plan._extraAllowed.insert(_extraAllowed.begin(), _extraAllowed.end());
 
         return res;
     }
@@ -528,30 +1117,22 @@ namespace dci::aup::impl
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     uint64 Applier::emplace(const fs::path& path, std::filesystem::perms perms, const Oid& content)
     {
-        auto blob = fetchContent(content);
-        if(!blob)
+        auto placement = placeContent(content);
+        if(!placement)
         {
             return rIncompleteStorage;
         }
 
         fs::create_directories(path.parent_path());
 
+        //без промежуточного буфера на весь объект
+        if(placement->_compressed)
         {
-            std::ofstream out{path.native().c_str(), std::ios_base::out | std::ios_base::binary};
-            if(!out)
-            {
-                throw std::system_error(errno, std::generic_category(), "unable to open "+path.string());
-            }
-            bytes::Cursor c {blob->begin()};
-            while(!c.atEnd())
-            {
-                if(!out.write(static_cast<const char *>(static_cast<const void *>(c.continuousData())), c.continuousDataSize()))
-                {
-                    throw std::system_error(errno, std::generic_category(), "unable to write "+path.string());
-                }
-
-                c.advanceChunks(1);
-            }
+            storage::Compressed::extract(placement->_path, path);
+        }
+        else
+        {
+            copyRange(placement->_path, placement->_offset, placement->_size, path);
         }
 
         fs::permissions(path, perms);
@@ -639,27 +1220,164 @@ namespace dci::aup::impl
     }
 
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
-    fs::perms Applier::permsFor(File* f)
+    uint64 Applier::mutate(const fs::path& root, const Action& action, std::optional<StatCache::Stat>& stat)
     {
-        return static_cast<fs::perms>(f->_perms);
+        fs::path path = root / action._path;
+        fs::perms perms = static_cast<fs::perms>(action._perms);
+
+        //в теневом дереве прежнего файла нет
+        if(root != _place)
+        {
+            uint64 res = emplace(path, perms, action._content);
+            if(rFixedMissings == res)
+            {
+                stat = StatCache::take(path);
+                return Action::Kind::emplace == action._kind ? rFixedMissings : rFixedChanges;
+            }
+            return res;
+        }
+
+        if(Action::Kind::emplace == action._kind)
+        {
+            uint64 res = emplace(path, perms, action._content);
+            if(rFixedMissings == res)
+            {
+                stat = StatCache::take(path);
+            }
+            return res;
+        }
+
+        uint64 res = update(path, perms, action._content);
+        if(rFixedChanges == res)
+        {
+            stat = StatCache::take(path);
+        }
+        return res;
     }
 
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
-    bool Applier::extraAllowed(std::filesystem::path path)
+    Action Applier::action(Action::Kind kind, const fs::path& path, const Point& point) const
     {
-        if(path.is_absolute())
+        return Action{kind, relative(path), point._ideal->_content, point._ideal->_perms, point._ideal->_size};
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Applier::link(const fs::path& origin, const fs::path& path)
+    {
+        fs::create_directories(path.parent_path());
+
+        //оставляемое неверное переносится как есть, не только файлы
+        fs::file_status status = fs::symlink_status(origin);
+        switch(status.type())
         {
-            path = path.lexically_relative(_place);
+        case fs::file_type::regular:
+            break;
+
+        case fs::file_type::symlink:
+            fs::copy_symlink(origin, path);
+            return;
+
+        case fs::file_type::directory:
+            //только сам каталог, содержимое переносится своими действиями
+            fs::create_directory(path);
+            fs::permissions(path, status.permissions());
+            return;
+
+        default:
+#ifdef __linux__
+            {
+                struct ::stat st;
+                if(::lstat(origin.c_str(), &st) || ::mknod(path.c_str(), st.st_mode, st.st_rdev))
+                {
+                    throw std::system_error(errno, std::generic_category(), "unable to recreate "+path.string());
+                }
+            }
+            return;
+#else
+            break;
+#endif
+        }
+
+        std::error_code ec;
+        fs::create_hard_link(origin, path, ec);
+        if(ec)
+        {
+            //другая фс или ссылки не поддерживаются
+            copyRange(origin, 0, fs::file_size(origin), path);
+            fs::permissions(path, fs::status(origin).permissions());
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    fs::path Applier::sibling(const std::string& suffix) const
+    {
+        fs::path place = _place;
+        if(place.filename().empty())
+        {
+            place = place.parent_path();
+        }
+
+        return place.parent_path() / (place.filename().string() + suffix);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Applier::switchTo(const fs::path& shadow)
+    {
+        if(!fs::exists(_place))
+        {
+            fs::rename(shadow, _place);
+            return;
         }
 
-        for(const std::string& pattern : _extraAllowed)
+        //прежнее дерево - для отката, одно поколение
+        fs::path previous = sibling(".aup-previous");
+        fs::remove_all(previous);
+
+        if(exchangePaths(shadow, _place))
         {
-            if(dci::utils::fnmatch(pattern.c_str(), path.string().c_str(), dci::utils::fnmPathName | dci::utils::fnmNoEscape))
+            fs::rename(shadow, previous);
+            return;
+        }
+
+        //без атомарного обмена - два переименования подряд
+        fs::rename(_place, previous);
+        fs::rename(shadow, _place);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Applier::carry(applier::Plan& plan, const fs::path& path, const Oid* content) const
+    {
+        if(_task & tShadow)
+        {
+            Action a{Action::Kind::link, relative(path)};
+            if(content)
             {
-                return true;
+                a._content = *content;
             }
+            plan._actions.push_back(std::move(a));
         }
+    }
 
-        return false;
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    std::string Applier::relative(const fs::path& path) const
+    {
+        return path.lexically_relative(_place).generic_string();
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    fs::perms Applier::permsFor(const File* f)
+    {
+        return static_cast<fs::perms>(f->_perms);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    bool Applier::extraAllowed(std::filesystem::path path)
+    {
+        if(path.is_absolute())
+        {
+            path = path.lexically_relative(_place);
+        }
+
+        return _extraAllowedMatcher.match(path.string());
     }
 }
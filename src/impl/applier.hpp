@@ -10,21 +10,29 @@
 #include <dci/aup/oid.hpp>
 #include <dci/aup/applier/task.hpp>
 #include <dci/aup/applier/result.hpp>
+#include <dci/aup/applier/plan.hpp>
 #include <dci/aup/catalog/object.hpp>
 #include <dci/aup/catalog/release.hpp>
 #include <dci/aup/catalog/unit.hpp>
 #include <dci/aup/catalog/file.hpp>
+#include <dci/aup/storage/mapping.hpp>
+#include "statCache.hpp"
+#include "scanTree.hpp"
+#include "pathMatcher.hpp"
+#include "oidInterner.hpp"
+#include "storage.hpp"
 #include <vector>
 #include <set>
 #include <filesystem>
 #include <optional>
+#include <mutex>
+#include <chrono>
 
 namespace fs = std::filesystem;
 
 namespace dci::aup::impl
 {
     class Catalog;
-    class Storage;
 
     class Applier final
     {
@@ -42,35 +50,76 @@ namespace dci::aup::impl
         void addCatalog(Catalog* c);
         void addStorage(Storage* s);
         void addRoot(const Oid& oid, const Set<aup::catalog::File::Kind>& fileKinds);
+        void setStatCache(Storage* s, const std::string& localPath, std::chrono::nanoseconds racyWindow = std::chrono::seconds{2});
+        void setDirty(std::optional<std::set<std::string>>&& dirty);
 
     public:
         applier::Result process(const std::string& place, applier::Task task = applier::tNull);
 
+        //разбор и решения без изменений в месте, затем исполнение готового плана
+        applier::Plan plan(const std::string& place, applier::Task task = applier::tNull);
+        applier::Result execute(const applier::Plan& plan);
+
+        //обмен места с деревом, оставленным теневым режимом
+        bool rollback(const std::string& place);
+
     private:
         void reset();
         uint64 traverse(const Oid& oid, const Set<aup::catalog::File::Kind>& fileKinds);
         void traverse(const fs::path& dir);
-        aup::catalog::ObjectPtr fetchObject(const Oid& oid);
+        void traverseDirty();
+        void traverseOne(const fs::path& path);
+        void record(fs::path&& path, const ScanEntry& entry);
+        const aup::catalog::Object* fetchObject(const Oid& oid);
 
         bool hasContent(const Oid& oid);
-        std::optional<Bytes> fetchContent(const Oid& oid);
+        std::optional<aup::storage::Mapping> mapContent(const Oid& oid);
+        std::optional<Storage::Placement> placeContent(const Oid& oid);
         void deleteContent(const Oid& oid);
-        Oid evaluateContentCheck(const fs::path& p);
+        static Oid evaluateContentCheck(const fs::path& p);
+
+        void loadStatCache();
+        void saveStatCache();
+        void dropStatCache();
 
     private:
-        uint64 synchronize();
+        struct Point;
+
+        void evaluateContentChecks();
+        uint64 synchronize(applier::Plan& plan);
         uint64 emplace(const fs::path& path, fs::perms perms, const Oid& content);
         uint64 remove(const fs::path& path);
         uint64 update(const fs::path& path, fs::perms perms, const Oid& content);
+        uint64 mutate(const fs::path& root, const applier::Action& action, std::optional<StatCache::Stat>& stat);
+        void link(const fs::path& origin, const fs::path& path);
+        fs::path sibling(const std::string& suffix) const;
+        void switchTo(const fs::path& shadow);
 
-        static fs::perms permsFor(aup::catalog::File* f);
+        applier::Action action(applier::Action::Kind kind, const fs::path& path, const Point& point) const;
+        void carry(applier::Plan& plan, const fs::path& path, const Oid* content) const;
+        std::string relative(const fs::path& path) const;
+
+        static fs::perms permsFor(const aup::catalog::File* f);
         bool extraAllowed(fs::path path);
 
     private:
         std::set<Catalog *>                             _catalogs;
         std::set<Storage *>                             _storages;
+        std::mutex                                      _storagesMtx;
         std::map<Oid, Set<aup::catalog::File::Kind>>    _roots;
 
+        Storage *                                       _statCacheStorage {};
+        std::string                                     _statCacheLocalPath;
+        std::chrono::nanoseconds                        _statCacheRacyWindow {std::chrono::seconds{2}};
+        StatCache                                       _statCache;
+
+        //подтвержденное построением плана, сохраняется исполнением этого плана
+        StatCache                                       _plannedStatCache;
+        std::optional<fs::path>                         _plannedPlace;
+
+        //измененное в месте с прошлого применения, nullopt - неизвестно
+        std::optional<std::set<std::string>>            _dirty;
+
     private:
         fs::path    _place;
         uint64      _task {};
@@ -80,7 +129,7 @@ namespace dci::aup::impl
         {
             bool                    _requiredAsDirectory {};
 
-            aup::catalog::FilePtr   _ideal;
+            const aup::catalog::File* _ideal {};
             Oid                     _idealOid {};
 
             bool                    _realWrong {};
@@ -88,11 +137,15 @@ namespace dci::aup::impl
             bool                    _realFile;
             fs::perms               _realPerms  {fs::perms::unknown};
             uint64                  _realSize   {};
+            std::optional<Oid>      _realContent;
+            std::optional<StatCache::Stat> _realStat;//с обхода, до вычисления _realContent
         };
 
-        std::set<Oid>               _traversed;
+        OidInterner                 _traversedOids;
+        HandleSet                   _traversed;
         std::map<fs::path, Point>   _points;
         std::set<std::string>       _extraAllowed;
+        PathMatcher                 _extraAllowedMatcher;//_extraAllowed, собранные перед синхронизацией
 
         std::set<fs::path>          _emptyDirCandidates;
     };
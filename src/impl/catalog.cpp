@@ -15,12 +15,21 @@
 #include <dci/aup/catalog/file.hpp>
 #include <dci/aup/catalog/object.hpp>
 #include <dci/aup/catalog/unit.hpp>
+#include <dci/aup/catalog/delta.hpp>
+#include <dci/aup/catalog/chunked.hpp>
 #include <dci/aup/catalog/identify.hpp>
 #include <dci/utils/b2h.hpp>
 #include <dci/logger.hpp>
+#include <algorithm>
 
 namespace dci::aup::impl
 {
+    namespace
+    {
+        constexpr uint64 g_changesMagic = 0x91e4b7c35d0a2f68;
+        constexpr uint64 g_changesMagicNoOids = 0x6a0c31f7d45e90b2;
+    }
+
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     Catalog::Catalog()
     {
@@ -34,42 +43,62 @@ namespace dci::aup::impl
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     void Catalog::reset()
     {
-        _objectsByOid.clear();
+        _objects.clear();
+        _snapshot.detach();
+        forgetChanges(Oid{});
     }
 
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
-    void Catalog::import(Catalog* from, bool(*filter)(const Oid& oid, const aup::catalog::ObjectPtr& object))
+    void Catalog::import(Catalog* from, bool(*filter)(const Oid& oid, const aup::catalog::Object* object))
     {
-        for(auto&[oid, obj] : from->_objectsByOid)
+        from->materializeAll();
+        from->_objects.forEach([&](const Oid& oid, aup::catalog::Object* obj)
         {
             if(!filter || filter(oid, obj))
             {
                 //LOGI("imported catalog entry: "<<utils::b2h(oid));
-                _objectsByOid.emplace(oid, std::move(obj));
+                if(_objects.insert(oid, std::move(*obj)))
+                {
+                    markPutted(oid);
+                }
             }
-        }
+        });
     }
 
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
-    uint32 Catalog::dropOthersThan(const Set<Oid>& keep)
+    uint32 Catalog::dropOthersThan(const OidInterner& oids, const HandleSet& keep)
     {
-        uint32 res{};
-
-        for(ObjectsByOid::iterator iter{_objectsByOid.begin()}; iter!=_objectsByOid.end(); )
+        std::vector<Oid> garbage;
+        _objects.forEach([&](const Oid& oid, const aup::catalog::Object*)
         {
-            const Oid& oid = iter->first;
-            if(keep.count(oid))
+            if(!keep.count(oids.find(oid)))
             {
-                ++iter;
+                garbage.push_back(oid);
             }
-            else
+        });
+
+        for(const Oid& oid : garbage)
+        {
+            markDeleted(oid);
+            _objects.erase(oid);
+        }
+
+        //не затронутые в снимке
+        for(std::size_t index{}; index<_snapshot.size(); ++index)
+        {
+            if(!_snapshot.consumed(index))
             {
-                iter = _objectsByOid.erase(iter);
-                ++res;
+                Oid oid = _snapshot.oid(index);
+                if(!keep.count(oids.find(oid)))
+                {
+                    _snapshot.consume(index);
+                    markDeleted(oid);
+                    garbage.push_back(oid);
+                }
             }
         }
 
-        return res;
+        return static_cast<uint32>(garbage.size());
     }
 
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
@@ -77,25 +106,104 @@ namespace dci::aup::impl
     {
         Bytes blob{std::move(blob_)};
 
-        if(blob.size() < Oid{}.size())//check
+        uint8 head[sizeof(uint64)] {};
         {
-            throw aup::Exception{"low data for deserialize catalog"};
+            bytes::Cursor c{blob.begin()};
+            c.read(head, sizeof(head));
         }
 
+        if(catalog::Snapshot::recognize(head, blob.size()))
         {
-            Oid check;
+            std::vector<uint8> buffer(blob.size());
             {
-                bytes::Alter a{blob.end()};
-                a.advance(-int32{check.size()});
-                a.removeTo(check.data(), check.size());
+                bytes::Cursor c{blob.begin()};
+                c.read(buffer.data(), blob.size());
             }
 
-            if(check != aup::catalog::identify(blob))
+            attached(_snapshot.attach(std::move(buffer)));
+            return;
+        }
+
+        deserializeFlat(std::move(blob));
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Catalog::attach(aup::storage::Mapping&& mapping)
+    {
+        if(catalog::Snapshot::recognize(mapping.data(), mapping.size()))
+        {
+            attached(_snapshot.attach(std::move(mapping)));
+            return;
+        }
+
+        //прежний формат, только целиком
+        if(mapping.size() > ~uint32{})
+        {
+            throw aup::Exception{"too big catalog for deserialize"};
+        }
+
+        Bytes blob;
+        blob.end().write(mapping.data(), static_cast<uint32>(mapping.size()));
+        mapping.close();
+
+        deserializeFlat(std::move(blob));
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    Bytes Catalog::serialize()
+    {
+        //в порядке oid, чтобы снимок не зависел от раскладки таблицы
+        std::vector<catalog::Snapshot::Item> items;
+        items.reserve(_objects.size() + _snapshot.size());
+
+        _objects.forEach([&](const Oid& oid, const aup::catalog::Object* object)
+        {
+            items.push_back(catalog::Snapshot::Item{oid, object->type(), nullptr, 0, object});
+        });
+
+        //не затронутые объекты прежнего снимка переносятся как есть, без декодирования
+        for(std::size_t index{}; index<_snapshot.size(); ++index)
+        {
+            if(!_snapshot.consumed(index))
             {
-                throw aup::Exception{"corrupted data for deserialize catalog"};
+                catalog::Snapshot::Item item{_snapshot.oid(index), _snapshot.type(index), nullptr, 0, nullptr};
+                if(_snapshot.raw(index, item._raw, item._rawSize))
+                {
+                    items.push_back(item);
+                }
             }
         }
 
+        Oid check;
+        Bytes blob = catalog::Snapshot::build(std::move(items), check);
+
+        forgetChanges(check);
+
+        return blob;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Catalog::deserializeFlat(Bytes&& blob_)
+    {
+        Bytes blob{std::move(blob_)};
+
+        if(blob.size() < Oid{}.size())//check
+        {
+            throw aup::Exception{"low data for deserialize catalog"};
+        }
+
+        Oid check;
+        {
+            bytes::Alter a{blob.end()};
+            a.advance(-int32{check.size()});
+            a.removeTo(check.data(), check.size());
+        }
+
+        if(check != aup::catalog::identify(blob))
+        {
+            throw aup::Exception{"corrupted data for deserialize catalog"};
+        }
+
         std::vector<aup::catalog::ObjectPtr> objects;
 
         {
@@ -123,10 +231,18 @@ namespace dci::aup::impl
         {
             put(std::move(o));
         }
+
+        forgetChanges(check);
     }
 
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
-    Bytes Catalog::serialize()
+    bool Catalog::changed() const
+    {
+        return !_putted.empty() || !_deleted.empty();
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    Bytes Catalog::serializeChanges()
     {
         Bytes blob;
 
@@ -134,35 +250,150 @@ namespace dci::aup::impl
             stiac::serialization::Arch arch{blob.begin()};
 
             //magic
-            arch << uint64{0xe32206afe2bced65};
+            arch << g_changesMagic;
+
+            //снимок, к которому применимы изменения
+            arch << _base;
 
             //content
-            for(const auto& [oid, object] : _objectsByOid)
+            arch << stiac::smallIntegral(uint64{_deleted.size()});
+            for(const Oid& oid : _deleted)
+            {
+                arch << oid;
+            }
+
+            for(const Oid& oid : _putted)
             {
-                (void)oid;
-                catalog::serializeObject(std::move(object), arch);
+                const aup::catalog::Object* object = _objects.find(oid);
+                if(object)
+                {
+                    //oid рядом с объектом, при чтении он покрыт общей проверкой и не пересчитывается
+                    arch << oid;
+                    catalog::serializeObject(object, arch);
+                }
             }
 
             //check
-            blob.end().write(aup::catalog::identify(blob));
+            Oid check = aup::catalog::identify(blob);
+            blob.end().write(check);
+
+            //следующая порция изменений применима поверх этой
+            forgetChanges(check);
         }
 
         return blob;
     }
 
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Catalog::deserializeChanges(Bytes&& blob_)
+    {
+        Bytes blob{std::move(blob_)};
+
+        if(blob.size() < Oid{}.size())//check
+        {
+            throw aup::Exception{"low data for deserialize catalog changes"};
+        }
+
+        Oid check;
+        {
+            bytes::Alter a{blob.end()};
+            a.advance(-int32{check.size()});
+            a.removeTo(check.data(), check.size());
+        }
+
+        if(check != aup::catalog::identify(blob))
+        {
+            throw aup::Exception{"corrupted data for deserialize catalog changes"};
+        }
+
+        std::vector<Oid> deleted;
+        std::vector<std::pair<Oid, aup::catalog::ObjectPtr>> putted;
+        bool withOids;
+
+        {
+            stiac::serialization::Arch arch{blob.begin()};
+
+            uint64 magic;
+            arch >> magic;
+
+            //прежний формат без oid у объектов
+            withOids = g_changesMagic == magic;
+            if(!withOids && g_changesMagicNoOids != magic)
+            {
+                throw aup::Exception{"unknown magic for deserialize catalog changes: "+std::to_string(magic)};
+            }
+
+            Oid base;
+            arch >> base;
+
+            if(base != _base)
+            {
+                throw aup::Exception{"catalog changes does not match to catalog"};
+            }
+
+            uint64 deletedAmount;
+            arch >> stiac::smallIntegral(deletedAmount);
+            deleted.resize(deletedAmount);
+            for(Oid& oid : deleted)
+            {
+                arch >> oid;
+            }
+
+            while(!arch.atEnd())
+            {
+                Oid oid{};
+                if(withOids)
+                {
+                    arch >> oid;
+                }
+
+                auto o = catalog::deserializeObject(arch);
+                if(o)
+                {
+                    putted.emplace_back(oid, std::move(o));
+                }
+            }
+        }
+
+        for(const Oid& oid : deleted)
+        {
+            del(oid);
+        }
+
+        for(auto&[oid, o] : putted)
+        {
+            if(withOids)
+            {
+                putIdentified(oid, std::move(o));
+            }
+            else
+            {
+                put(std::move(o));
+            }
+        }
+
+        forgetChanges(check);
+    }
+
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     Set<Oid> Catalog::enumerate(aup::catalog::Object::Type type)
     {
         Set<Oid> res;
 
-        for(ObjectsByOid::iterator iter{_objectsByOid.begin()}; iter!=_objectsByOid.end(); ++iter)
+        _objects.forEach([&](const Oid& oid, const aup::catalog::Object* object)
         {
-            const aup::catalog::ObjectPtr& object = iter->second;
             if(aup::catalog::Object::Type::null == type || object->type() == type)
             {
-                const Oid& oid = iter->first;
                 res.insert(oid);
             }
+        });
+
+        for(std::size_t index{}; index<_snapshot.size(); ++index)
+        {
+            if(!_snapshot.consumed(index) && (aup::catalog::Object::Type::null == type || _snapshot.type(index) == type))
+            {
+                res.insert(_snapshot.oid(index));
+            }
         }
 
         return res;
@@ -172,43 +403,50 @@ namespace dci::aup::impl
     Oid Catalog::put(aup::catalog::ObjectPtr&& object)
     {
         Oid oid = identify(object.get());
-
-        _objectsByOid.insert_or_assign(oid, std::move(object));
-
+        putIdentified(oid, std::move(object));
         return oid;
     }
 
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     bool Catalog::has(const Oid& oid)
     {
-        return _objectsByOid.count(oid);
+        return find(oid);
     }
 
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     aup::catalog::ObjectPtr Catalog::get(const Oid& oid)
     {
-        auto iter = _objectsByOid.find(oid);
-        if(_objectsByOid.end() == iter)
+        const aup::catalog::Object* o = find(oid);
+        if(!o)
         {
             return {};
         }
 
-        aup::catalog::Object* o = iter->second.get();
         switch(o->type())
         {
         case aup::catalog::Object::Type::file:
             {
-                return std::make_unique<aup::catalog::File>(*static_cast<aup::catalog::File*>(o));
+                return std::make_unique<aup::catalog::File>(*static_cast<const aup::catalog::File*>(o));
             }
             break;
         case aup::catalog::Object::Type::unit:
             {
-                return std::make_unique<aup::catalog::Unit>(*static_cast<aup::catalog::Unit*>(o));
+                return std::make_unique<aup::catalog::Unit>(*static_cast<const aup::catalog::Unit*>(o));
             }
             break;
         case aup::catalog::Object::Type::release:
             {
-                return std::make_unique<aup::catalog::Release>(*static_cast<aup::catalog::Release*>(o));
+                return std::make_unique<aup::catalog::Release>(*static_cast<const aup::catalog::Release*>(o));
+            }
+            break;
+        case aup::catalog::Object::Type::delta:
+            {
+                return std::make_unique<aup::catalog::Delta>(*static_cast<const aup::catalog::Delta*>(o));
+            }
+            break;
+        case aup::catalog::Object::Type::chunked:
+            {
+                return std::make_unique<aup::catalog::Chunked>(*static_cast<const aup::catalog::Chunked*>(o));
             }
             break;
         default:
@@ -219,15 +457,117 @@ namespace dci::aup::impl
         return {};
     }
 
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    const aup::catalog::Object* Catalog::find(const Oid& oid) const
+    {
+        if(const aup::catalog::Object* o = _objects.find(oid))
+        {
+            return o;
+        }
+
+        return materialize(oid);
+    }
+
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     void Catalog::del(const Oid& oid)
     {
-        auto iter = _objectsByOid.find(oid);
-        if(_objectsByOid.end() == iter)
+        if(_objects.erase(oid))
         {
+            markDeleted(oid);
             return;
         }
 
-        _objectsByOid.erase(iter);
+        std::size_t index = _snapshot.locate(oid);
+        if(catalog::Snapshot::_npos != index)
+        {
+            _snapshot.consume(index);
+            markDeleted(oid);
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Catalog::putIdentified(const Oid& oid, aup::catalog::ObjectPtr&& object)
+    {
+        if(catalog::Snapshot::_npos != _snapshot.locate(oid))
+        {
+            return;
+        }
+
+        if(_objects.insert(oid, std::move(*object)))
+        {
+            markPutted(oid);
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Catalog::markPutted(const Oid& oid)
+    {
+        _deleted.erase(oid);
+        _putted.insert(oid);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Catalog::markDeleted(const Oid& oid)
+    {
+        _putted.erase(oid);
+        _deleted.insert(oid);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Catalog::forgetChanges(const Oid& base)
+    {
+        _base = base;
+        _putted.clear();
+        _deleted.clear();
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Catalog::attached(const Oid& check)
+    {
+        //уже разобранные объекты в снимке не дублируются
+        _objects.forEach([&](const Oid& oid, const aup::catalog::Object*)
+        {
+            std::size_t index = _snapshot.locate(oid);
+            if(catalog::Snapshot::_npos != index)
+            {
+                _snapshot.consume(index);
+            }
+        });
+
+        forgetChanges(check);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    const aup::catalog::Object* Catalog::materialize(const Oid& oid) const
+    {
+        std::size_t index = _snapshot.locate(oid);
+        if(catalog::Snapshot::_npos == index)
+        {
+            return nullptr;
+        }
+
+        aup::catalog::ObjectPtr o = _snapshot.decode(index);
+        _snapshot.consume(index);
+
+        if(!o)
+        {
+            LOGW("corrupted catalog entry dropped: "<<utils::b2h(oid));
+            return nullptr;
+        }
+
+        _objects.insert(oid, std::move(*o));
+        return _objects.find(oid);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Catalog::materializeAll()
+    {
+        for(std::size_t index{}; index<_snapshot.size(); ++index)
+        {
+            if(!_snapshot.consumed(index))
+            {
+                materialize(_snapshot.oid(index));
+            }
+        }
     }
 }
@@ -9,6 +9,10 @@
 
 #include <dci/bytes.hpp>
 #include <dci/aup/catalog/object.hpp>
+#include <dci/aup/storage/mapping.hpp>
+#include "catalog/objectTable.hpp"
+#include "catalog/snapshot.hpp"
+#include "oidInterner.hpp"
 
 namespace dci::aup::impl::catalog
 {
@@ -32,14 +36,22 @@ namespace dci::aup::impl
     public:
         void reset();
 
-        void import(Catalog* from, bool(*filter)(const Oid& oid, const aup::catalog::ObjectPtr& object));
+        void import(Catalog* from, bool(*filter)(const Oid& oid, const aup::catalog::Object* object));
 
-        uint32 dropOthersThan(const Set<Oid>& keep);
+        uint32 dropOthersThan(const OidInterner& oids, const HandleSet& keep);
 
     public://весь индекс в блоб и обратно
         void deserialize(Bytes&& blob);
         Bytes serialize();
 
+        //снимок подключается без разбора, объекты декодируются при первом обращении
+        void attach(aup::storage::Mapping&& mapping);
+
+    public://изменения относительно последнего полного снимка (deserialize/serialize) в блоб и обратно
+        bool changed() const;
+        Bytes serializeChanges();
+        void deserializeChanges(Bytes&& blob);
+
     public://перечисление
         Set<Oid> enumerate(aup::catalog::Object::Type type = aup::catalog::Object::Type::null);
 
@@ -49,8 +61,27 @@ namespace dci::aup::impl
         aup::catalog::ObjectPtr get(const Oid& oid);
         void del(const Oid& oid);
 
+    public://доступ без копирования, указатель валиден до изменения каталога
+        const aup::catalog::Object* find(const Oid& oid) const;
+
+    private:
+        void putIdentified(const Oid& oid, aup::catalog::ObjectPtr&& object);
+        void markPutted(const Oid& oid);
+        void markDeleted(const Oid& oid);
+        void forgetChanges(const Oid& base);
+
+        void deserializeFlat(Bytes&& blob);
+        void attached(const Oid& check);
+        const aup::catalog::Object* materialize(const Oid& oid) const;
+        void materializeAll();
+
+    private:
+        mutable catalog::ObjectTable    _objects;
+        mutable catalog::Snapshot       _snapshot;
+
     private:
-        using ObjectsByOid = std::map<Oid, aup::catalog::ObjectPtr>;
-        ObjectsByOid _objectsByOid;
+        Oid         _base {};
+        Set<Oid>    _putted;
+        Set<Oid>    _deleted;
     };
 }
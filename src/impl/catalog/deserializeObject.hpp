@@ -33,6 +33,12 @@ namespace dci::aup::impl::catalog
             case aup::catalog::Object::Type::release:
                 object = std::make_unique<aup::catalog::Release>();
                 break;
+            case aup::catalog::Object::Type::delta:
+                object = std::make_unique<aup::catalog::Delta>();
+                break;
+            case aup::catalog::Object::Type::chunked:
+                object = std::make_unique<aup::catalog::Chunked>();
+                break;
             default:
                 //throw aup::Exception{"unknown object type for deserialize catalog: "+std::to_string(static_cast<std::underlying_type_t<aup::catalog::Object::Type>>(otype))};
                 return aup::catalog::ObjectPtr{};
@@ -13,6 +13,8 @@
 #include <dci/aup/catalog/file.hpp>
 #include <dci/aup/catalog/object.hpp>
 #include <dci/aup/catalog/unit.hpp>
+#include <dci/aup/catalog/delta.hpp>
+#include <dci/aup/catalog/chunked.hpp>
 
 namespace dci::aup::impl::catalog
 {
@@ -61,6 +63,24 @@ namespace dci::aup::impl::catalog
                 f(c->_signature);
             }
             break;
+        case aup::catalog::Object::Type::delta:
+            {
+                auto* c = aup::catalog::objectPtrCast<aup::catalog::Delta>(object);
+                f(c->_base);
+                f(c->_target);
+                f(stiac::smallIntegral(c->_size));
+                f(c->_content);
+            }
+            break;
+        case aup::catalog::Object::Type::chunked:
+            {
+                auto* c = aup::catalog::objectPtrCast<aup::catalog::Chunked>(object);
+                f(c->_target);
+                f(stiac::smallIntegral(c->_size));
+                f(c->_chunks);
+                f(c->_chunkSizes);
+            }
+            break;
         default:
             dbgWarn("bad object type");
             throw aup::Exception{"bad object type provided"};
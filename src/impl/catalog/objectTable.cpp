@@ -0,0 +1,231 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+#include "objectTable.hpp"
+#include "../oidHash.hpp"
+#include <dci/aup/exception.hpp>
+
+namespace dci::aup::impl::catalog
+{
+    namespace
+    {
+        template <class O>
+        O* arenaAlloc(auto& arena, O&& object)
+        {
+            if(arena._free.empty())
+            {
+                return &arena._items.emplace_back(std::move(object));
+            }
+
+            O* res = arena._free.back();
+            arena._free.pop_back();
+            *res = std::move(object);
+            return res;
+        }
+
+        template <class O>
+        void arenaFree(auto& arena, O* object)
+        {
+            //отпустить строки и множества сразу, само место останется для следующего
+            *object = O{};
+            arena._free.push_back(object);
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    ObjectTable::ObjectTable()
+    {
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    ObjectTable::~ObjectTable()
+    {
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void ObjectTable::clear()
+    {
+        _slots.clear();
+        _size = 0;
+
+        _files = {};
+        _units = {};
+        _releases = {};
+        _deltas = {};
+        _chunkeds = {};
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    std::size_t ObjectTable::size() const
+    {
+        return _size;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    aup::catalog::Object* ObjectTable::find(const Oid& oid) const
+    {
+        if(_slots.empty())
+        {
+            return nullptr;
+        }
+
+        std::size_t mask = _slots.size() - 1;
+        for(std::size_t i = home(oid); ; i = (i + 1) & mask)
+        {
+            const Slot& slot = _slots[i];
+            if(!slot._object)
+            {
+                return nullptr;
+            }
+
+            if(slot._oid == oid)
+            {
+                return slot._object;
+            }
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    bool ObjectTable::insert(const Oid& oid, aup::catalog::Object&& object)
+    {
+        if((_size + 1) * 4 > _slots.size() * 3)
+        {
+            grow();
+        }
+
+        std::size_t mask = _slots.size() - 1;
+        for(std::size_t i = home(oid); ; i = (i + 1) & mask)
+        {
+            Slot& slot = _slots[i];
+            if(!slot._object)
+            {
+                slot._oid = oid;
+                slot._object = alloc(std::move(object));
+                _size++;
+                return true;
+            }
+
+            if(slot._oid == oid)
+            {
+                return false;
+            }
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    bool ObjectTable::erase(const Oid& oid)
+    {
+        if(_slots.empty())
+        {
+            return false;
+        }
+
+        std::size_t mask = _slots.size() - 1;
+        std::size_t i = home(oid);
+        for(; ; i = (i + 1) & mask)
+        {
+            if(!_slots[i]._object)
+            {
+                return false;
+            }
+
+            if(_slots[i]._oid == oid)
+            {
+                break;
+            }
+        }
+
+        free(_slots[i]._object);
+        _slots[i] = Slot{};
+        _size--;
+
+        //сдвинуть назад хвост цепочки, чтобы не рвать пробирование
+        for(std::size_t j = (i + 1) & mask; _slots[j]._object; j = (j + 1) & mask)
+        {
+            std::size_t h = home(_slots[j]._oid);
+            if(((j - h) & mask) >= ((j - i) & mask))
+            {
+                _slots[i] = _slots[j];
+                _slots[j] = Slot{};
+                i = j;
+            }
+        }
+
+        return true;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    std::size_t ObjectTable::home(const Oid& oid) const
+    {
+        return OidHash{}(oid) & (_slots.size() - 1);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void ObjectTable::grow()
+    {
+        std::vector<Slot> slots(_slots.empty() ? std::size_t{64} : _slots.size() * 2);
+        slots.swap(_slots);
+
+        std::size_t mask = _slots.size() - 1;
+        for(const Slot& slot : slots)
+        {
+            if(!slot._object)
+            {
+                continue;
+            }
+
+            std::size_t i = home(slot._oid);
+            while(_slots[i]._object)
+            {
+                i = (i + 1) & mask;
+            }
+            _slots[i] = slot;
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    aup::catalog::Object* ObjectTable::alloc(aup::catalog::Object&& object)
+    {
+        switch(object.type())
+        {
+        case aup::catalog::Object::Type::file:
+            return arenaAlloc(_files, std::move(static_cast<aup::catalog::File&>(object)));
+        case aup::catalog::Object::Type::unit:
+            return arenaAlloc(_units, std::move(static_cast<aup::catalog::Unit&>(object)));
+        case aup::catalog::Object::Type::release:
+            return arenaAlloc(_releases, std::move(static_cast<aup::catalog::Release&>(object)));
+        case aup::catalog::Object::Type::delta:
+            return arenaAlloc(_deltas, std::move(static_cast<aup::catalog::Delta&>(object)));
+        case aup::catalog::Object::Type::chunked:
+            return arenaAlloc(_chunkeds, std::move(static_cast<aup::catalog::Chunked&>(object)));
+        default:
+            dbgWarn("bad object type");
+            throw aup::Exception{"bad object type provided"};
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void ObjectTable::free(aup::catalog::Object* object)
+    {
+        switch(object->type())
+        {
+        case aup::catalog::Object::Type::file:
+            return arenaFree(_files, static_cast<aup::catalog::File*>(object));
+        case aup::catalog::Object::Type::unit:
+            return arenaFree(_units, static_cast<aup::catalog::Unit*>(object));
+        case aup::catalog::Object::Type::release:
+            return arenaFree(_releases, static_cast<aup::catalog::Release*>(object));
+        case aup::catalog::Object::Type::delta:
+            return arenaFree(_deltas, static_cast<aup::catalog::Delta*>(object));
+        case aup::catalog::Object::Type::chunked:
+            return arenaFree(_chunkeds, static_cast<aup::catalog::Chunked*>(object));
+        default:
+            dbgWarn("bad object type");
+            break;
+        }
+    }
+}
@@ -0,0 +1,103 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+#pragma once
+
+#include <dci/aup/catalog/object.hpp>
+#include <dci/aup/catalog/file.hpp>
+#include <dci/aup/catalog/unit.hpp>
+#include <dci/aup/catalog/release.hpp>
+#include <dci/aup/catalog/delta.hpp>
+#include <dci/aup/catalog/chunked.hpp>
+#include <deque>
+#include <vector>
+
+namespace dci::aup::impl::catalog
+{
+    /* объекты каталога
+     *
+     * тела лежат в деках по типам (адреса стабильны, места от удаленных переиспользуются),
+     * поиск по oid - открытая адресация с линейным пробированием и удалением сдвигом, без надгробий
+     */
+    class ObjectTable final
+    {
+        ObjectTable(const ObjectTable&) = delete;
+        ObjectTable(ObjectTable&&) = delete;
+
+        void operator=(const ObjectTable&) = delete;
+        void operator=(ObjectTable&&) = delete;
+
+    public:
+        ObjectTable();
+        ~ObjectTable();
+
+        void clear();
+        std::size_t size() const;
+
+        aup::catalog::Object* find(const Oid& oid) const;
+        bool insert(const Oid& oid, aup::catalog::Object&& object);
+        bool erase(const Oid& oid);
+
+        void forEach(auto&& f) const;
+        void forEach(auto&& f);
+
+    private:
+        struct Slot
+        {
+            Oid                     _oid {};
+            aup::catalog::Object*   _object {};
+        };
+
+        std::size_t home(const Oid& oid) const;
+        void grow();
+
+        aup::catalog::Object* alloc(aup::catalog::Object&& object);
+        void free(aup::catalog::Object* object);
+
+    private:
+        std::vector<Slot>   _slots;
+        std::size_t         _size {};
+
+    private:
+        template <class O>
+        struct Arena
+        {
+            std::deque<O>   _items;
+            std::vector<O*> _free;
+        };
+
+        Arena<aup::catalog::File>       _files;
+        Arena<aup::catalog::Unit>       _units;
+        Arena<aup::catalog::Release>    _releases;
+        Arena<aup::catalog::Delta>      _deltas;
+        Arena<aup::catalog::Chunked>    _chunkeds;
+    };
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void ObjectTable::forEach(auto&& f) const
+    {
+        for(const Slot& slot : _slots)
+        {
+            if(slot._object)
+            {
+                f(slot._oid, static_cast<const aup::catalog::Object*>(slot._object));
+            }
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void ObjectTable::forEach(auto&& f)
+    {
+        for(const Slot& slot : _slots)
+        {
+            if(slot._object)
+            {
+                f(slot._oid, slot._object);
+            }
+        }
+    }
+}
@@ -14,15 +14,22 @@ namespace dci::aup::impl::catalog
 {
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     template <class O>
-    inline void serializeObject(const std::unique_ptr<O>& objectPtr, auto& dst)
+    inline void serializeObject(const O* object, auto& dst)
     {
-        dst << objectPtr->type();
-        catalog::enumerateObjectFields(objectPtr.get(), [&](const auto& fld)
+        dst << object->type();
+        catalog::enumerateObjectFields(object, [&](const auto& fld)
         {
             dst << fld;
         });
     }
 
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    template <class O>
+    inline void serializeObject(const std::unique_ptr<O>& objectPtr, auto& dst)
+    {
+        serializeObject(objectPtr.get(), dst);
+    }
+
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     template <class O>
     inline Bytes serializeObject(const std::unique_ptr<O>& objectPtr)
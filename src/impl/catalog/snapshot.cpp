@@ -0,0 +1,314 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+#include "snapshot.hpp"
+#include "serializeObject.hpp"
+#include "deserializeObject.hpp"
+#include <dci/aup/exception.hpp>
+#include <dci/aup/catalog/identify.hpp>
+#include <algorithm>
+#include <cstring>
+
+namespace dci::aup::impl::catalog
+{
+    namespace
+    {
+        constexpr uint64 g_magic = 0x4b7d1e09c3a25f86;
+
+        //magic, count
+        constexpr std::size_t g_headerSize = sizeof(uint64) + sizeof(uint64);
+
+        //oid, offset, size, type, выравнивание
+        constexpr std::size_t g_entrySize = sizeof(Oid) + sizeof(uint64) + sizeof(uint32) + sizeof(uint8) + 3;
+
+        template <class T>
+        T load(const uint8* src)
+        {
+            T res;
+            std::memcpy(&res, src, sizeof(res));
+            return res;
+        }
+
+        template <class T>
+        void store(uint8* dst, const T& v)
+        {
+            std::memcpy(dst, &v, sizeof(v));
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    Snapshot::Snapshot()
+    {
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    Snapshot::~Snapshot()
+    {
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    bool Snapshot::recognize(const uint8* data, uint64 size)
+    {
+        return size >= sizeof(uint64) && g_magic == load<uint64>(data);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    Bytes Snapshot::build(std::vector<Item>&& items, Oid& check)
+    {
+        std::sort(items.begin(), items.end(), [](const Item& a, const Item& b)
+        {
+            return a._oid < b._oid;
+        });
+
+        std::vector<uint8> head(g_headerSize + items.size() * g_entrySize);
+        store(head.data(), g_magic);
+        store(head.data() + sizeof(uint64), uint64{items.size()});
+
+        Bytes body;
+        uint64 offset{};
+        {
+            bytes::Alter a{body.end()};
+            uint8* e = head.data() + g_headerSize;
+
+            for(const Item& item : items)
+            {
+                uint32 size = item._rawSize;
+
+                if(item._raw)
+                {
+                    a.write(item._raw, size);
+                }
+                else
+                {
+                    Bytes one;
+                    {
+                        stiac::serialization::Arch arch{one.begin()};
+                        serializeObject(item._object, arch);
+                    }
+                    size = one.size();
+
+                    bytes::Cursor c{one.begin()};
+                    while(!c.atEnd())
+                    {
+                        a.write(c.continuousData(), c.continuousDataSize());
+                        c.advanceChunks(1);
+                    }
+                }
+
+                std::memcpy(e, item._oid.data(), item._oid.size());
+                store(e + sizeof(Oid), offset);
+                store(e + sizeof(Oid) + sizeof(uint64), size);
+                store(e + sizeof(Oid) + sizeof(uint64) + sizeof(uint32), static_cast<uint8>(item._type));
+
+                offset += size;
+                e += g_entrySize;
+            }
+        }
+
+        check = aup::catalog::identify(head.data(), head.size());
+
+        Bytes res;
+        {
+            bytes::Alter a{res.end()};
+            a.write(head.data(), static_cast<uint32>(head.size()));
+
+            bytes::Cursor c{body.begin()};
+            while(!c.atEnd())
+            {
+                a.write(c.continuousData(), c.continuousDataSize());
+                c.advanceChunks(1);
+            }
+
+            a.write(check.data(), static_cast<uint32>(check.size()));
+        }
+
+        return res;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    Oid Snapshot::attach(aup::storage::Mapping&& mapping)
+    {
+        detach();
+
+        _mapping.emplace(std::move(mapping));
+        _data = _mapping->data();
+        _dataSize = _mapping->size();
+
+        return parse();
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    Oid Snapshot::attach(std::vector<uint8>&& buffer)
+    {
+        detach();
+
+        _buffer = std::move(buffer);
+        _data = _buffer.data();
+        _dataSize = _buffer.size();
+
+        return parse();
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Snapshot::detach()
+    {
+        _mapping.reset();
+        _buffer.clear();
+        _buffer.shrink_to_fit();
+
+        _data = nullptr;
+        _dataSize = 0;
+
+        _count = 0;
+        _body = nullptr;
+        _bodySize = 0;
+
+        _consumed.clear();
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    std::size_t Snapshot::size() const
+    {
+        return _count;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    std::size_t Snapshot::locate(const Oid& oid) const
+    {
+        std::size_t lo{}, hi{_count};
+        while(lo < hi)
+        {
+            std::size_t mid = lo + (hi - lo) / 2;
+            int cmp = std::memcmp(entry(mid), oid.data(), oid.size());
+            if(cmp < 0)
+            {
+                lo = mid + 1;
+            }
+            else if(cmp > 0)
+            {
+                hi = mid;
+            }
+            else
+            {
+                return _consumed[mid] ? _npos : mid;
+            }
+        }
+
+        return _npos;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    Oid Snapshot::oid(std::size_t index) const
+    {
+        Oid res;
+        std::memcpy(res.data(), entry(index), res.size());
+        return res;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    aup::catalog::Object::Type Snapshot::type(std::size_t index) const
+    {
+        return static_cast<aup::catalog::Object::Type>(entry(index)[sizeof(Oid) + sizeof(uint64) + sizeof(uint32)]);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    bool Snapshot::raw(std::size_t index, const uint8*& data, uint32& size) const
+    {
+        const uint8* e = entry(index);
+        uint64 offset = load<uint64>(e + sizeof(Oid));
+        size = load<uint32>(e + sizeof(Oid) + sizeof(uint64));
+
+        if(offset > _bodySize || size > _bodySize - offset)
+        {
+            return false;
+        }
+
+        data = _body + offset;
+        return true;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    bool Snapshot::consumed(std::size_t index) const
+    {
+        return _consumed[index];
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Snapshot::consume(std::size_t index)
+    {
+        _consumed[index] = true;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    aup::catalog::ObjectPtr Snapshot::decode(std::size_t index) const
+    {
+        const uint8* data;
+        uint32 size;
+        if(!raw(index, data, size))
+        {
+            return {};
+        }
+
+        //тело проверяется своим же oid
+        if(oid(index) != aup::catalog::identify(data, size))
+        {
+            return {};
+        }
+
+        Bytes blob;
+        blob.end().write(data, size);
+
+        aup::catalog::ObjectPtr res = deserializeObject(std::move(blob));
+        if(!res || res->type() != type(index))
+        {
+            return {};
+        }
+
+        return res;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    Oid Snapshot::parse()
+    {
+        Oid check;
+
+        if(_dataSize < g_headerSize + check.size() || !recognize(_data, _dataSize))
+        {
+            detach();
+            throw aup::Exception{"bad catalog snapshot header"};
+        }
+
+        uint64 count = load<uint64>(_data + sizeof(uint64));
+        if(count > (_dataSize - g_headerSize - check.size()) / g_entrySize)
+        {
+            detach();
+            throw aup::Exception{"bad catalog snapshot table"};
+        }
+
+        std::size_t headSize = g_headerSize + static_cast<std::size_t>(count) * g_entrySize;
+
+        std::memcpy(check.data(), _data + _dataSize - check.size(), check.size());
+        if(check != aup::catalog::identify(_data, headSize))
+        {
+            detach();
+            throw aup::Exception{"corrupted catalog snapshot table"};
+        }
+
+        _count = static_cast<std::size_t>(count);
+        _body = _data + headSize;
+        _bodySize = _dataSize - headSize - check.size();
+        _consumed.assign(_count, false);
+
+        return check;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    const uint8* Snapshot::entry(std::size_t index) const
+    {
+        return _data + g_headerSize + index * g_entrySize;
+    }
+}
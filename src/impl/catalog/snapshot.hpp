@@ -0,0 +1,87 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+#pragma once
+
+#include <dci/bytes.hpp>
+#include <dci/aup/catalog/object.hpp>
+#include <dci/aup/storage/mapping.hpp>
+#include <optional>
+#include <vector>
+
+namespace dci::aup::impl::catalog
+{
+    /* полный снимок каталога с таблицей смещений, объекты декодируются по одному при обращении
+     *
+     * magic, count, таблица [oid, offset, size, type] упорядоченная по oid, тела объектов, check
+     * check - хэш заголовка с таблицей, тело каждого объекта проверяется своим oid при декодировании
+     */
+    class Snapshot final
+    {
+        Snapshot(const Snapshot&) = delete;
+        Snapshot(Snapshot&&) = delete;
+
+        void operator=(const Snapshot&) = delete;
+        void operator=(Snapshot&&) = delete;
+
+    public:
+        static constexpr std::size_t _npos = ~std::size_t{};
+
+        struct Item
+        {
+            Oid                             _oid {};
+            aup::catalog::Object::Type      _type {};
+
+            //либо готовое сериализованное тело, либо объект
+            const uint8*                    _raw {};
+            uint32                          _rawSize {};
+            const aup::catalog::Object*     _object {};
+        };
+
+    public:
+        Snapshot();
+        ~Snapshot();
+
+        static bool recognize(const uint8* data, uint64 size);
+        static Bytes build(std::vector<Item>&& items, Oid& check);
+
+        Oid attach(aup::storage::Mapping&& mapping);
+        Oid attach(std::vector<uint8>&& buffer);
+        void detach();
+
+    public:
+        std::size_t size() const;
+        std::size_t locate(const Oid& oid) const;
+
+        Oid oid(std::size_t index) const;
+        aup::catalog::Object::Type type(std::size_t index) const;
+        bool raw(std::size_t index, const uint8*& data, uint32& size) const;
+
+        //объект переехал в каталог или удален, из снимка более не доступен
+        bool consumed(std::size_t index) const;
+        void consume(std::size_t index);
+
+        aup::catalog::ObjectPtr decode(std::size_t index) const;
+
+    private:
+        Oid parse();
+        const uint8* entry(std::size_t index) const;
+
+    private:
+        std::optional<aup::storage::Mapping>    _mapping;
+        std::vector<uint8>                      _buffer;
+
+        const uint8*                            _data {};
+        uint64                                  _dataSize {};
+
+        std::size_t                             _count {};
+        const uint8*                            _body {};
+        uint64                                  _bodySize {};
+
+        std::vector<bool>                       _consumed;
+    };
+}
@@ -0,0 +1,227 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+#include "copyRange.hpp"
+#include "storage/seek.hpp"
+#include <dci/utils/atScopeExit.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <system_error>
+#include <vector>
+
+#ifndef _WIN32
+#   include <fcntl.h>
+#   include <unistd.h>
+#   include <sys/stat.h>
+#endif
+
+#ifdef __linux__
+#   include <sys/ioctl.h>
+#   include <sys/sendfile.h>
+#   include <linux/fs.h>
+#endif
+
+namespace dci::aup::impl
+{
+    namespace
+    {
+        constexpr std::size_t g_bufferSize = std::size_t{1} << 20;
+        constexpr uint64 g_chunkSize = uint64{1} << 30;
+
+#ifdef __linux__
+        //отказ ядра или фс от ускоренного пути, не ошибка данных
+        bool unsupported(int err)
+        {
+            return ENOSYS == err || EXDEV == err || EINVAL == err || EOPNOTSUPP == err || ENOTSUP == err || EBADF == err;
+        }
+#endif
+    }
+
+#ifdef _WIN32
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void copyRange(const std::filesystem::path& src, uint64 offset, uint64 size, const std::filesystem::path& dst)
+    {
+        std::FILE* in = fopen(src.string().c_str(), "rb");
+        if(!in)
+        {
+            throw std::system_error(errno, std::generic_category(), "unable to open "+src.string());
+        }
+        utils::AtScopeExit inCloser{[&]
+        {
+            fclose(in);
+        }};
+
+        std::FILE* out = fopen(dst.string().c_str(), "wb");
+        if(!out)
+        {
+            throw std::system_error(errno, std::generic_category(), "unable to open "+dst.string());
+        }
+        utils::AtScopeExit outCloser{[&]
+        {
+            fclose(out);
+        }};
+
+        if(storage::seek(in, offset))
+        {
+            throw std::system_error(errno, std::generic_category(), "unable to seek "+src.string());
+        }
+
+        std::vector<char> buf(g_bufferSize);
+        while(size)
+        {
+            std::size_t portion = static_cast<std::size_t>(std::min<uint64>(size, buf.size()));
+            if(portion != fread(buf.data(), 1, portion, in))
+            {
+                throw std::system_error(ferror(in) ? errno : EIO, std::generic_category(), "unable to read "+src.string());
+            }
+
+            if(portion != fwrite(buf.data(), 1, portion, out))
+            {
+                throw std::system_error(errno, std::generic_category(), "unable to write "+dst.string());
+            }
+
+            size -= portion;
+        }
+
+        if(fflush(out))
+        {
+            throw std::system_error(errno, std::generic_category(), "unable to write "+dst.string());
+        }
+    }
+#else
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void copyRange(const std::filesystem::path& src, uint64 offset, uint64 size, const std::filesystem::path& dst)
+    {
+        int in = ::open(src.c_str(), O_RDONLY | O_CLOEXEC);
+        if(0 > in)
+        {
+            throw std::system_error(errno, std::generic_category(), "unable to open "+src.string());
+        }
+        utils::AtScopeExit inCloser{[&]
+        {
+            ::close(in);
+        }};
+
+        int out = ::open(dst.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+        if(0 > out)
+        {
+            throw std::system_error(errno, std::generic_category(), "unable to open "+dst.string());
+        }
+        utils::AtScopeExit outCloser{[&]
+        {
+            ::close(out);
+        }};
+
+        off_t inOff = static_cast<off_t>(offset);
+
+#ifdef __linux__
+#   ifdef FICLONE
+        //весь файл - общие с хранилищем блоки, если фс умеет
+        if(!offset)
+        {
+            struct ::stat st;
+            if(!::fstat(in, &st) && static_cast<uint64>(st.st_size) == size && !::ioctl(out, FICLONE, in))
+            {
+                return;
+            }
+        }
+#   endif
+
+        //в ядре, в том числе между разными фс на свежих ядрах
+        bool kernelCopy = true;
+        while(size && kernelCopy)
+        {
+            ssize_t n = ::copy_file_range(in, &inOff, out, nullptr, static_cast<std::size_t>(std::min(size, g_chunkSize)), 0);
+            if(0 < n)
+            {
+                size -= static_cast<uint64>(n);
+            }
+            else if(!n)
+            {
+                throw std::system_error(EIO, std::generic_category(), "unexpected end of "+src.string());
+            }
+            else if(EINTR == errno)
+            {
+                continue;
+            }
+            else if(unsupported(errno))
+            {
+                kernelCopy = false;
+            }
+            else
+            {
+                throw std::system_error(errno, std::generic_category(), "unable to copy "+src.string()+" to "+dst.string());
+            }
+        }
+
+        kernelCopy = true;
+        while(size && kernelCopy)
+        {
+            ssize_t n = ::sendfile(out, in, &inOff, static_cast<std::size_t>(std::min(size, g_chunkSize)));
+            if(0 < n)
+            {
+                size -= static_cast<uint64>(n);
+            }
+            else if(!n)
+            {
+                throw std::system_error(EIO, std::generic_category(), "unexpected end of "+src.string());
+            }
+            else if(EINTR == errno)
+            {
+                continue;
+            }
+            else if(unsupported(errno))
+            {
+                kernelCopy = false;
+            }
+            else
+            {
+                throw std::system_error(errno, std::generic_category(), "unable to copy "+src.string()+" to "+dst.string());
+            }
+        }
+#endif
+
+        //потоково, память ограничена буфером
+        std::vector<char> buf(size ? static_cast<std::size_t>(std::min<uint64>(size, g_bufferSize)) : 0);
+        while(size)
+        {
+            ssize_t n = ::pread(in, buf.data(), static_cast<std::size_t>(std::min<uint64>(size, buf.size())), inOff);
+            if(0 > n)
+            {
+                if(EINTR == errno)
+                {
+                    continue;
+                }
+                throw std::system_error(errno, std::generic_category(), "unable to read "+src.string());
+            }
+            if(!n)
+            {
+                throw std::system_error(EIO, std::generic_category(), "unexpected end of "+src.string());
+            }
+
+            inOff += n;
+            size -= static_cast<uint64>(n);
+
+            const char* cur = buf.data();
+            while(n)
+            {
+                ssize_t w = ::write(out, cur, static_cast<std::size_t>(n));
+                if(0 > w)
+                {
+                    if(EINTR == errno)
+                    {
+                        continue;
+                    }
+                    throw std::system_error(errno, std::generic_category(), "unable to write "+dst.string());
+                }
+                cur += w;
+                n -= w;
+            }
+        }
+    }
+#endif
+}
@@ -0,0 +1,21 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+#pragma once
+
+#include <dci/primitives.hpp>
+#include <filesystem>
+
+namespace dci::aup::impl
+{
+    /* диапазон [offset, offset+size) файла src в новый файл dst, при ошибке - std::system_error
+     *
+     * по возможности без прохода данных через пользовательское пространство:
+     * reflink всего файла, copy_file_range, sendfile, иначе потоковое копирование ограниченным буфером
+     */
+    void copyRange(const std::filesystem::path& src, uint64 offset, uint64 size, const std::filesystem::path& dst);
+}
@@ -0,0 +1,41 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+#include "exchangePaths.hpp"
+#include <system_error>
+#include <cerrno>
+
+#ifdef __linux__
+#   include <cstdio>
+#   include <fcntl.h>
+#   include <linux/fs.h>
+#endif
+
+namespace dci::aup::impl
+{
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    bool exchangePaths(const std::filesystem::path& a, const std::filesystem::path& b)
+    {
+#if defined(__linux__) && defined(RENAME_EXCHANGE)
+        if(!::renameat2(AT_FDCWD, a.c_str(), AT_FDCWD, b.c_str(), RENAME_EXCHANGE))
+        {
+            return true;
+        }
+
+        if(ENOSYS == errno || EINVAL == errno || EOPNOTSUPP == errno)
+        {
+            return false;
+        }
+
+        throw std::system_error(errno, std::generic_category(), "unable to exchange "+a.string()+" and "+b.string());
+#else
+        (void)a;
+        (void)b;
+        return false;
+#endif
+    }
+}
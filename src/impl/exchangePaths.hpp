@@ -0,0 +1,18 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+#pragma once
+
+#include <filesystem>
+
+namespace dci::aup::impl
+{
+    /* атомарный обмен двух путей одним вызовом (renameat2 RENAME_EXCHANGE)
+     * false - система или фс не умеет, ничего не изменено; прочие ошибки - std::system_error
+     */
+    bool exchangePaths(const std::filesystem::path& a, const std::filesystem::path& b);
+}
@@ -0,0 +1,30 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <string_view>
+
+namespace dci::aup::impl
+{
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    //служебные файлы экземпляра, лежат в хранилище рядом с объектами под своими именами
+    inline constexpr char g_catalogPath[] = "catalog";
+    inline constexpr char g_catalogJournalPath[] = "catalog.journal";
+    inline constexpr char g_targetStatPath[] = "target.stat";
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    //не объект и не мусор, перечисление содержимого хранилища их пропускает
+    inline bool isMetaPath(std::string_view localPath)
+    {
+        constexpr std::array<std::string_view, 3> all{g_catalogPath, g_catalogJournalPath, g_targetStatPath};
+        return all.end() != std::find(all.begin(), all.end(), localPath);
+    }
+}
@@ -0,0 +1,27 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+#pragma once
+
+#include <dci/aup/oid.hpp>
+#include <cstring>
+
+namespace dci::aup::impl
+{
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    //oid - это уже криптографический хэш, любые его 8 байт распределены равномерно
+    struct OidHash
+    {
+        std::size_t operator()(const Oid& oid) const noexcept
+        {
+            std::size_t res;
+            static_assert(sizeof(res) <= sizeof(Oid));
+            std::memcpy(&res, oid.data(), sizeof(res));
+            return res;
+        }
+    };
+}
@@ -0,0 +1,158 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+
+#include "oidInterner.hpp"
+#include "oidHash.hpp"
+#include <algorithm>
+
+namespace dci::aup::impl
+{
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    OidInterner::OidInterner()
+    {
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    OidInterner::~OidInterner()
+    {
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void OidInterner::clear()
+    {
+        _oids.clear();
+        _slots.clear();
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    std::size_t OidInterner::size() const
+    {
+        return _oids.size();
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    OidInterner::Handle OidInterner::intern(const Oid& oid)
+    {
+        if((_oids.size() + 1) * 4 > _slots.size() * 3)
+        {
+            grow();
+        }
+
+        std::size_t mask = _slots.size() - 1;
+        for(std::size_t i = home(oid); ; i = (i + 1) & mask)
+        {
+            Handle& slot = _slots[i];
+            if(_null == slot)
+            {
+                slot = static_cast<Handle>(_oids.size());
+                _oids.push_back(oid);
+                return slot;
+            }
+
+            if(_oids[slot] == oid)
+            {
+                return slot;
+            }
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    OidInterner::Handle OidInterner::find(const Oid& oid) const
+    {
+        if(_slots.empty())
+        {
+            return _null;
+        }
+
+        std::size_t mask = _slots.size() - 1;
+        for(std::size_t i = home(oid); ; i = (i + 1) & mask)
+        {
+            Handle slot = _slots[i];
+            if(_null == slot || _oids[slot] == oid)
+            {
+                return slot;
+            }
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    const Oid& OidInterner::oid(Handle handle) const
+    {
+        return _oids[handle];
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    std::size_t OidInterner::home(const Oid& oid) const
+    {
+        return OidHash{}(oid) & (_slots.size() - 1);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void OidInterner::grow()
+    {
+        //удалений нет, перестроить по вектору проще чем переносить слоты
+        _slots.assign(_slots.empty() ? std::size_t{64} : _slots.size() * 2, _null);
+
+        std::size_t mask = _slots.size() - 1;
+        for(Handle handle{}; handle < _oids.size(); ++handle)
+        {
+            std::size_t i = home(_oids[handle]);
+            while(_null != _slots[i])
+            {
+                i = (i + 1) & mask;
+            }
+            _slots[i] = handle;
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void HandleSet::clear()
+    {
+        _bits.clear();
+        _size = 0;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    std::size_t HandleSet::size() const
+    {
+        return _size;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    bool HandleSet::insert(Handle handle)
+    {
+        std::size_t word = handle / 64;
+        uint64 bit = uint64{1} << (handle % 64);
+
+        if(word >= _bits.size())
+        {
+            _bits.resize(std::max(word + 1, _bits.size() * 2));
+        }
+
+        if(_bits[word] & bit)
+        {
+            return false;
+        }
+
+        _bits[word] |= bit;
+        _size++;
+        return true;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    bool HandleSet::count(Handle handle) const
+    {
+        std::size_t word = handle / 64;
+        if(word >= _bits.size())
+        {
+            return false;
+        }
+
+        return _bits[word] & (uint64{1} << (handle % 64));
+    }
+}
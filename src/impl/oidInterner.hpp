@@ -0,0 +1,68 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+
+#pragma once
+
+#include <dci/aup/oid.hpp>
+#include <vector>
+
+namespace dci::aup::impl
+{
+    /* плотные номера для oid
+     *
+     * oid получает номер при первом интернировании, номера идут подряд с нуля,
+     * поиск - открытая адресация по номерам, сами oid лежат в векторе по номеру
+     */
+    class OidInterner final
+    {
+        OidInterner(const OidInterner&) = delete;
+        void operator=(const OidInterner&) = delete;
+
+    public:
+        using Handle = uint32;
+        static constexpr Handle _null = ~Handle{};
+
+    public:
+        OidInterner();
+        ~OidInterner();
+
+        void clear();
+        std::size_t size() const;
+
+        Handle intern(const Oid& oid);
+        Handle find(const Oid& oid) const;//_null если не интернирован
+        const Oid& oid(Handle handle) const;
+
+    private:
+        std::size_t home(const Oid& oid) const;
+        void grow();
+
+    private:
+        std::vector<Oid>    _oids;
+        std::vector<Handle> _slots;
+    };
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    //множество номеров битовой картой
+    class HandleSet final
+    {
+    public:
+        using Handle = OidInterner::Handle;
+
+    public:
+        void clear();
+        std::size_t size() const;
+
+        bool insert(Handle handle);//true если не было
+        bool count(Handle handle) const;
+
+    private:
+        std::vector<uint64> _bits;
+        std::size_t         _size {};
+    };
+}
@@ -0,0 +1,88 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+#pragma once
+
+#include <dci/primitives.hpp>
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace dci::aup::impl
+{
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    inline std::size_t defaultConcurrency()
+    {
+        return std::max(std::size_t{1}, std::size_t{std::thread::hardware_concurrency()});
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    /* fn(index) для каждого index из [0, amount) на пуле из concurrency потоков,
+     * вызывающий поток тоже работает, первое исключение пробрасывается после завершения всех
+     */
+    template <class F>
+    void parallelFor(std::size_t amount, F&& fn, std::size_t concurrency = defaultConcurrency())
+    {
+        std::atomic<std::size_t> next {0};
+        std::exception_ptr failure;
+        std::mutex failureMtx;
+
+        auto worker = [&]
+        {
+            for(;;)
+            {
+                std::size_t index = next.fetch_add(1, std::memory_order_relaxed);
+                if(index >= amount)
+                {
+                    break;
+                }
+
+                try
+                {
+                    fn(index);
+                }
+                catch(...)
+                {
+                    std::lock_guard lock{failureMtx};
+                    if(!failure)
+                    {
+                        failure = std::current_exception();
+                    }
+
+                    //остальное не нужно
+                    next.store(amount, std::memory_order_relaxed);
+                }
+            }
+        };
+
+        std::vector<std::thread> threads;
+        std::size_t extra = std::min(concurrency, amount);
+        if(extra > 1)
+        {
+            threads.reserve(extra - 1);
+            for(std::size_t i{1}; i<extra; ++i)
+            {
+                threads.emplace_back(worker);
+            }
+        }
+
+        worker();
+
+        for(std::thread& t : threads)
+        {
+            t.join();
+        }
+
+        if(failure)
+        {
+            std::rethrow_exception(failure);
+        }
+    }
+}
@@ -0,0 +1,195 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+
+#include "pathMatcher.hpp"
+#include <dci/utils/fnmatch.hpp>
+#include <algorithm>
+
+namespace dci::aup::impl
+{
+    namespace
+    {
+        /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+        bool isGlob(const std::string& segment)
+        {
+            return std::string::npos != segment.find_first_of("*?[");
+        }
+
+        /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+        bool splittable(const std::string& pattern)
+        {
+            //'/' внутри [...] не делит шаблон на компоненты
+            bool bracket = false;
+            for(std::size_t i{}; i<pattern.size(); ++i)
+            {
+                char c = pattern[i];
+                if(!bracket)
+                {
+                    if('[' == c)
+                    {
+                        bracket = true;
+                        if(i+1 < pattern.size() && ('!' == pattern[i+1] || '^' == pattern[i+1])) ++i;
+                        if(i+1 < pattern.size() && ']' == pattern[i+1]) ++i;
+                    }
+                }
+                else if(']' == c)
+                {
+                    bracket = false;
+                }
+                else if('/' == c)
+                {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    PathMatcher::PathMatcher()
+    {
+        clear();
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    PathMatcher::~PathMatcher()
+    {
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void PathMatcher::compile(const std::set<std::string>& patterns)
+    {
+        clear();
+
+        for(const std::string& pattern : patterns)
+        {
+            if(!splittable(pattern))
+            {
+                _whole.push_back(pattern);
+                continue;
+            }
+
+            uint32 node = 0;
+            for(std::size_t pos{};;)
+            {
+                std::size_t end = pattern.find('/', pos);
+                node = child(node, pattern.substr(pos, end - pos));
+
+                if(std::string::npos == end)
+                {
+                    break;
+                }
+                pos = end + 1;
+            }
+
+            _nodes[node]._terminal = true;
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void PathMatcher::clear()
+    {
+        _nodes.clear();
+        _nodes.emplace_back();
+        _whole.clear();
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    bool PathMatcher::match(const std::string& path) const
+    {
+        std::vector<uint32> active{0};
+        std::vector<uint32> next;
+        std::string segment;
+
+        for(std::size_t pos{}; !active.empty();)
+        {
+            std::size_t end = path.find('/', pos);
+            segment.assign(path, pos, end - pos);
+
+            next.clear();
+            for(uint32 node : active)
+            {
+                const Node& n = _nodes[node];
+
+                auto iter = n._literals.find(segment);
+                if(n._literals.end() != iter)
+                {
+                    next.push_back(iter->second);
+                }
+
+                for(const auto&[glob, to] : n._globs)
+                {
+                    if(utils::fnmatch(glob.c_str(), segment.c_str(), utils::fnmPathName | utils::fnmNoEscape))
+                    {
+                        next.push_back(to);
+                    }
+                }
+            }
+
+            std::sort(next.begin(), next.end());
+            next.erase(std::unique(next.begin(), next.end()), next.end());
+            active.swap(next);
+
+            if(std::string::npos == end)
+            {
+                break;
+            }
+            pos = end + 1;
+        }
+
+        for(uint32 node : active)
+        {
+            if(_nodes[node]._terminal)
+            {
+                return true;
+            }
+        }
+
+        for(const std::string& pattern : _whole)
+        {
+            if(utils::fnmatch(pattern.c_str(), path.c_str(), utils::fnmPathName | utils::fnmNoEscape))
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    uint32 PathMatcher::child(uint32 node, std::string&& segment)
+    {
+        if(isGlob(segment))
+        {
+            for(const auto&[glob, to] : _nodes[node]._globs)
+            {
+                if(glob == segment)
+                {
+                    return to;
+                }
+            }
+
+            uint32 to = static_cast<uint32>(_nodes.size());
+            _nodes.emplace_back();
+            _nodes[node]._globs.emplace_back(std::move(segment), to);
+            return to;
+        }
+
+        auto iter = _nodes[node]._literals.find(segment);
+        if(_nodes[node]._literals.end() != iter)
+        {
+            return iter->second;
+        }
+
+        uint32 to = static_cast<uint32>(_nodes.size());
+        _nodes.emplace_back();
+        _nodes[node]._literals.emplace(std::move(segment), to);
+        return to;
+    }
+}
@@ -0,0 +1,50 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+
+#pragma once
+
+#include <dci/primitives.hpp>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace dci::aup::impl
+{
+    /* набор шаблонов fnmatch (fnmPathName | fnmNoEscape), собранный в дерево по компонентам пути
+     *
+     * литеральные компоненты - поиском в таблице узла, с подстановками - fnmatch только по своему компоненту,
+     * путь проходится один раз независимо от числа шаблонов
+     * шаблоны с '/' внутри [...] не раскладываются и проверяются целиком
+     */
+    class PathMatcher final
+    {
+    public:
+        PathMatcher();
+        ~PathMatcher();
+
+        void compile(const std::set<std::string>& patterns);
+        void clear();
+
+        bool match(const std::string& path) const;
+
+    private:
+        struct Node
+        {
+            std::unordered_map<std::string, uint32>     _literals;
+            std::vector<std::pair<std::string, uint32>> _globs;
+            bool                                        _terminal {};
+        };
+
+        uint32 child(uint32 node, std::string&& segment);
+
+    private:
+        std::vector<Node>           _nodes;
+        std::vector<std::string>    _whole;
+    };
+}
@@ -0,0 +1,259 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+
+#include "scanTree.hpp"
+#include <dci/utils/atScopeExit.hpp>
+#include <system_error>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+#include <string>
+
+#ifdef __linux__
+#   include <fcntl.h>
+#   include <unistd.h>
+#   include <sys/stat.h>
+#   include <sys/syscall.h>
+#   include <dirent.h>
+#endif
+
+namespace dci::aup::impl
+{
+    namespace fs = std::filesystem;
+
+#if defined(__linux__) && defined(STATX_BASIC_STATS) && defined(SYS_getdents64)
+    namespace
+    {
+        struct Dirent64
+        {
+            uint64          _ino;
+            int64           _off;
+            unsigned short  _reclen;
+            unsigned char   _type;
+            char            _name[1];
+        };
+
+        constexpr std::size_t g_bufferSize = 64 * 1024;
+        constexpr unsigned g_statxMask = STATX_TYPE | STATX_MODE | STATX_INO | STATX_SIZE | STATX_MTIME | STATX_CTIME;
+
+        /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+        void fill(ScanEntry& e, const struct statx& stx)
+        {
+            switch(stx.stx_mode & S_IFMT)
+            {
+            case S_IFREG:
+                e._kind = ScanEntry::Kind::file;
+                e._perms = static_cast<fs::perms>(stx.stx_mode & 07777);
+                e._size = stx.stx_size;
+                e._stat.emplace();
+                e._stat->_inode = stx.stx_ino;
+                e._stat->_size = stx.stx_size;
+                e._stat->_mtime = int64{stx.stx_mtime.tv_sec} * 1'000'000'000 + stx.stx_mtime.tv_nsec;
+                e._stat->_ctime = int64{stx.stx_ctime.tv_sec} * 1'000'000'000 + stx.stx_ctime.tv_nsec;
+                e._stat->_mode = stx.stx_mode & 07777;
+                break;
+            case S_IFDIR:
+                e._kind = ScanEntry::Kind::directory;
+                break;
+            default:
+                e._kind = ScanEntry::Kind::other;
+                break;
+            }
+        }
+
+        /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+        void scanDir(int dirFd, const fs::path& dirPath, const std::function<void(fs::path&&, const ScanEntry&)>& f)
+        {
+            std::vector<std::string> subdirs;
+
+            {
+                std::vector<char> buf(g_bufferSize);
+
+                for(;;)
+                {
+                    long amount = ::syscall(SYS_getdents64, dirFd, buf.data(), buf.size());
+                    if(0 > amount)
+                    {
+                        throw std::system_error(errno, std::generic_category(), "unable to read directory "+dirPath.string());
+                    }
+
+                    if(!amount)
+                    {
+                        break;
+                    }
+
+                    for(long pos{}; pos < amount;)
+                    {
+                        const Dirent64* d = reinterpret_cast<const Dirent64*>(buf.data() + pos);
+                        pos += d->_reclen;
+
+                        const char* name = d->_name;
+                        if('.' == name[0] && (!name[1] || ('.' == name[1] && !name[2])))
+                        {
+                            continue;
+                        }
+
+                        ScanEntry e;
+
+                        if(DT_DIR == d->_type)
+                        {
+                            e._kind = ScanEntry::Kind::directory;
+                            subdirs.emplace_back(name);
+                        }
+                        else if(DT_REG == d->_type || DT_LNK == d->_type || DT_UNKNOWN == d->_type)
+                        {
+                            //ссылка - по цели, остальное - без раскрытия
+                            struct statx stx;
+                            if(::statx(dirFd, name, DT_LNK == d->_type ? 0 : AT_SYMLINK_NOFOLLOW, g_statxMask, &stx))
+                            {
+                                if(ENOENT != errno)
+                                {
+                                    throw std::system_error(errno, std::generic_category(), "unable to stat "+(dirPath / name).string());
+                                }
+
+                                if(DT_LNK != d->_type)
+                                {
+                                    //пропал из-под ног
+                                    continue;
+                                }
+                            }
+                            else
+                            {
+                                fill(e, stx);
+
+                                if(ScanEntry::Kind::directory == e._kind && DT_LNK != d->_type)
+                                {
+                                    subdirs.emplace_back(name);
+                                }
+                            }
+                        }
+
+                        f(dirPath / name, e);
+                    }
+                }
+            }
+
+            for(const std::string& name : subdirs)
+            {
+                int fd = ::openat(dirFd, name.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+                if(0 > fd)
+                {
+                    if(ENOENT == errno)
+                    {
+                        continue;
+                    }
+
+                    throw std::system_error(errno, std::generic_category(), "unable to open directory "+(dirPath / name).string());
+                }
+                utils::AtScopeExit closer{[&]{::close(fd);}};
+
+                scanDir(fd, dirPath / name, f);
+            }
+        }
+    }
+#endif
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void scanTree(const fs::path& root, const std::function<void(fs::path&&, const ScanEntry&)>& f)
+    {
+#if defined(__linux__) && defined(STATX_BASIC_STATS) && defined(SYS_getdents64)
+        int fd = ::open(root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if(0 > fd)
+        {
+            throw std::system_error(errno, std::generic_category(), "unable to open directory "+root.string());
+        }
+        utils::AtScopeExit closer{[&]{::close(fd);}};
+
+        scanDir(fd, root, f);
+#else
+        for(const fs::directory_entry& entry : fs::recursive_directory_iterator(root))
+        {
+            ScanEntry e;
+
+            if(entry.is_regular_file())
+            {
+                e._kind = ScanEntry::Kind::file;
+                e._perms = entry.status().permissions();
+                e._size = entry.file_size();
+                e._stat = StatCache::take(entry.path());
+            }
+            else if(entry.is_directory())
+            {
+                e._kind = ScanEntry::Kind::directory;
+            }
+
+            f(fs::path{entry.path()}, e);
+        }
+#endif
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    std::optional<ScanEntry> scanOne(const fs::path& path, bool& descend)
+    {
+        descend = false;
+
+#if defined(__linux__) && defined(STATX_BASIC_STATS) && defined(SYS_getdents64)
+        struct statx stx;
+        if(::statx(AT_FDCWD, path.c_str(), AT_SYMLINK_NOFOLLOW, g_statxMask, &stx))
+        {
+            if(ENOENT == errno || ENOTDIR == errno)
+            {
+                return {};
+            }
+
+            throw std::system_error(errno, std::generic_category(), "unable to stat "+path.string());
+        }
+
+        ScanEntry res;
+
+        if(S_IFLNK == (stx.stx_mode & S_IFMT))
+        {
+            //ссылка - по цели, как и при обходе
+            if(!::statx(AT_FDCWD, path.c_str(), 0, g_statxMask, &stx))
+            {
+                fill(res, stx);
+            }
+            else if(ENOENT != errno)
+            {
+                throw std::system_error(errno, std::generic_category(), "unable to stat "+path.string());
+            }
+
+            return res;
+        }
+
+        fill(res, stx);
+        descend = ScanEntry::Kind::directory == res._kind;
+        return res;
+#else
+        std::error_code ec;
+        fs::file_status ls = fs::symlink_status(path, ec);
+        if(ec || !fs::exists(ls))
+        {
+            return {};
+        }
+
+        ScanEntry res;
+
+        fs::file_status st = fs::status(path, ec);
+        if(fs::is_regular_file(st))
+        {
+            res._kind = ScanEntry::Kind::file;
+            res._perms = st.permissions();
+            res._size = fs::file_size(path);
+            res._stat = StatCache::take(path);
+        }
+        else if(fs::is_directory(st))
+        {
+            res._kind = ScanEntry::Kind::directory;
+            descend = !fs::is_symlink(ls);
+        }
+
+        return res;
+#endif
+    }
+}
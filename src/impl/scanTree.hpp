@@ -0,0 +1,46 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+
+#pragma once
+
+#include "statCache.hpp"
+#include <dci/primitives.hpp>
+#include <filesystem>
+#include <functional>
+#include <optional>
+
+namespace dci::aup::impl
+{
+    struct ScanEntry
+    {
+        enum class Kind
+        {
+            file,
+            directory,
+            other,
+        };
+
+        Kind                            _kind {Kind::other};
+        std::filesystem::perms          _perms {std::filesystem::perms::unknown};
+        uint64                          _size {};
+        std::optional<StatCache::Stat>  _stat;
+    };
+
+    /* обход дерева под root (сам root не сообщается), при ошибке - std::system_error
+     *
+     * на linux - openat/getdents64 с d_type и по одному statx на файл: тип, права, размер и состояние для кэша разом,
+     * иначе - std::filesystem
+     * символическая ссылка получает тип цели, но как каталог не обходится
+     */
+    void scanTree(const std::filesystem::path& root, const std::function<void(std::filesystem::path&&, const ScanEntry&)>& f);
+
+    /* одиночный путь в тех же понятиях, nullopt - пути нет
+     * descend - путь является каталогом (не ссылкой на него) и его содержимое обходится scanTree
+     */
+    std::optional<ScanEntry> scanOne(const std::filesystem::path& path, bool& descend);
+}
@@ -0,0 +1,283 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+#include "statCache.hpp"
+#include <dci/stiac/serialization.hpp>
+#include <dci/aup/exception.hpp>
+#include <dci/aup/catalog/identify.hpp>
+#include <chrono>
+
+#ifndef _WIN32
+#   include <sys/stat.h>
+#endif
+
+namespace dci::aup::impl
+{
+    namespace
+    {
+        constexpr uint64 g_magic = 0x2d84f1c6b9e05a73;
+        constexpr uint64 g_magicNoTask = 0x5c31a7e08f6d29b4;//без задачи и оставленного, читается с неизвестной задачей
+
+        int64 now()
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    std::optional<StatCache::Stat> StatCache::take(const std::filesystem::path& path)
+    {
+#ifdef _WIN32
+        std::error_code ec;
+        Stat res;
+        res._size = std::filesystem::file_size(path, ec);
+        if(ec)
+        {
+            return {};
+        }
+
+        res._mtime = std::chrono::duration_cast<std::chrono::nanoseconds>(std::filesystem::last_write_time(path, ec).time_since_epoch()).count();
+        if(ec)
+        {
+            return {};
+        }
+
+        return res;
+#else
+        struct ::stat st;
+        if(::stat(path.c_str(), &st))
+        {
+            return {};
+        }
+
+        Stat res;
+        res._inode = static_cast<uint64>(st.st_ino);
+        res._size = static_cast<uint64>(st.st_size);
+        res._mtime = int64{st.st_mtim.tv_sec} * 1'000'000'000 + st.st_mtim.tv_nsec;
+        res._ctime = int64{st.st_ctim.tv_sec} * 1'000'000'000 + st.st_ctim.tv_nsec;
+        res._mode = static_cast<uint32>(st.st_mode & 07777);
+        return res;
+#endif
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    StatCache::StatCache()
+    {
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    StatCache::~StatCache()
+    {
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void StatCache::clear()
+    {
+        _entries.clear();
+        _extraAllowed.clear();
+        _task = ~uint64{};
+        _kept.clear();
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void StatCache::swap(StatCache& other)
+    {
+        _entries.swap(other._entries);
+        _extraAllowed.swap(other._extraAllowed);
+        std::swap(_task, other._task);
+        _kept.swap(other._kept);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void StatCache::deserialize(Bytes&& blob_, const std::string& place, std::chrono::nanoseconds racyWindow)
+    {
+        clear();
+
+        Bytes blob{std::move(blob_)};
+
+        if(blob.size() < Oid{}.size())//check
+        {
+            throw aup::Exception{"low data for deserialize stat cache"};
+        }
+
+        Oid check;
+        {
+            bytes::Alter a{blob.end()};
+            a.advance(-int32{check.size()});
+            a.removeTo(check.data(), check.size());
+        }
+
+        if(check != aup::catalog::identify(blob))
+        {
+            throw aup::Exception{"corrupted data for deserialize stat cache"};
+        }
+
+        stiac::serialization::Arch arch{blob.begin()};
+
+        uint64 magic;
+        arch >> magic;
+
+        if(g_magic != magic && g_magicNoTask != magic)
+        {
+            throw aup::Exception{"unknown magic for deserialize stat cache: "+std::to_string(magic)};
+        }
+
+        std::string cachedPlace;
+        arch >> cachedPlace;
+
+        if(cachedPlace != place)
+        {
+            //кэш от другого целевого каталога
+            return;
+        }
+
+        int64 savedAt;
+        arch >> savedAt;
+
+        uint64 amount;
+
+        if(g_magic == magic)
+        {
+            arch >> _task;
+
+            arch >> stiac::smallIntegral(amount);
+            for(uint64 i{}; i<amount; ++i)
+            {
+                std::string key;
+                arch >> key;
+                _kept.insert(std::move(key));
+            }
+        }
+
+        arch >> stiac::smallIntegral(amount);
+
+        for(uint64 i{}; i<amount; ++i)
+        {
+            std::string pattern;
+            arch >> pattern;
+            _extraAllowed.insert(std::move(pattern));
+        }
+
+        arch >> stiac::smallIntegral(amount);
+
+        for(uint64 i{}; i<amount; ++i)
+        {
+            std::string key;
+            Entry e;
+            arch >> key >> e._stat._inode >> e._stat._size >> e._stat._mtime >> e._stat._ctime >> e._stat._mode >> e._content >> e._racy;
+
+            //изменения того же такта времени, что и сохранение, не различимы
+            if(std::max(e._stat._mtime, e._stat._ctime) + racyWindow.count() > savedAt)
+            {
+                e._racy = true;
+            }
+
+            _entries.emplace(std::move(key), e);
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    Bytes StatCache::serialize(const std::string& place, std::chrono::nanoseconds racyWindow)
+    {
+        Bytes blob;
+
+        {
+            stiac::serialization::Arch arch{blob.begin()};
+
+            arch << g_magic;
+            arch << place;
+            int64 savedAt = now();
+            arch << savedAt;
+
+            arch << _task;
+            arch << stiac::smallIntegral(uint64{_kept.size()});
+            for(const std::string& key : _kept)
+            {
+                arch << key;
+            }
+
+            arch << stiac::smallIntegral(uint64{_extraAllowed.size()});
+            for(const std::string& pattern : _extraAllowed)
+            {
+                arch << pattern;
+            }
+
+            arch << stiac::smallIntegral(uint64{_entries.size()});
+            for(const auto&[key, e] : _entries)
+            {
+                //недоверие переживает пересохранение
+                bool racy = e._racy || std::max(e._stat._mtime, e._stat._ctime) + racyWindow.count() > savedAt;
+                arch << key << e._stat._inode << e._stat._size << e._stat._mtime << e._stat._ctime << e._stat._mode << e._content << racy;
+            }
+
+            Oid check = aup::catalog::identify(blob);
+            blob.end().write(check);
+        }
+
+        return blob;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    const Oid* StatCache::find(const std::string& key, const Stat& stat) const
+    {
+        auto iter = _entries.find(key);
+        if(_entries.end() == iter || iter->second._racy || iter->second._stat != stat)
+        {
+            return nullptr;
+        }
+
+        return &iter->second._content;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void StatCache::put(const std::string& key, const Stat& stat, const Oid& content)
+    {
+        _entries.insert_or_assign(key, Entry{stat, content});
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    const std::set<std::string>& StatCache::extraAllowed() const
+    {
+        return _extraAllowed;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void StatCache::setExtraAllowed(const std::set<std::string>& extraAllowed)
+    {
+        _extraAllowed = extraAllowed;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    uint64 StatCache::task() const
+    {
+        return _task;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void StatCache::setTask(uint64 task)
+    {
+        _task = task;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    const std::set<std::string>& StatCache::kept() const
+    {
+        return _kept;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void StatCache::setKept(std::set<std::string>&& kept)
+    {
+        _kept = std::move(kept);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    const std::map<std::string, StatCache::Entry>& StatCache::entries() const
+    {
+        return _entries;
+    }
+}
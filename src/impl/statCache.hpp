@@ -0,0 +1,91 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+#pragma once
+
+#include <dci/bytes.hpp>
+#include <dci/aup/oid.hpp>
+#include <filesystem>
+#include <chrono>
+#include <optional>
+#include <map>
+#include <set>
+
+namespace dci::aup::impl
+{
+    /* содержимое файлов целевого каталога по их состоянию (inode, size, mtime, ctime)
+     *
+     * пока состояние файла не изменилось - его содержимое не пересчитывается,
+     * записи, изменившиеся незадолго до сохранения кэша, не доверяются (грубая гранулярность времени в фс),
+     * но остаются известными - для выборочной проверки цели по следящему за ней;
+     * выборочная проверка допустима только при тех же задаче и допущенном лишнем и без оставленного на месте
+     */
+    class StatCache final
+    {
+        StatCache(const StatCache&) = delete;
+        StatCache(StatCache&&) = delete;
+
+        void operator=(const StatCache&) = delete;
+        void operator=(StatCache&&) = delete;
+
+    public:
+        struct Stat
+        {
+            uint64  _inode {};
+            uint64  _size {};
+            int64   _mtime {};//ns
+            int64   _ctime {};//ns
+            uint32  _mode {};//права
+
+            bool operator==(const Stat&) const = default;
+        };
+
+        static std::optional<Stat> take(const std::filesystem::path& path);
+
+    public:
+        StatCache();
+        ~StatCache();
+
+        void clear();
+        void swap(StatCache& other);
+
+        //racyWindow - запас на гранулярность времени модификации в фс
+        void deserialize(Bytes&& blob, const std::string& place, std::chrono::nanoseconds racyWindow);
+        Bytes serialize(const std::string& place, std::chrono::nanoseconds racyWindow);
+
+        const Oid* find(const std::string& key, const Stat& stat) const;
+        void put(const std::string& key, const Stat& stat, const Oid& content);
+
+        //допущенное лишнее, при котором построен кэш
+        const std::set<std::string>& extraAllowed() const;
+        void setExtraAllowed(const std::set<std::string>& extraAllowed);
+
+        //биты задачи, при которых построен кэш, ~0 - неизвестны
+        uint64 task() const;
+        void setTask(uint64 task);
+
+        //лишнее и неверное, оставленное на месте
+        const std::set<std::string>& kept() const;
+        void setKept(std::set<std::string>&& kept);
+
+    public:
+        struct Entry
+        {
+            Stat    _stat;
+            Oid     _content;
+            bool    _racy {};//не доверяется
+        };
+
+        const std::map<std::string, Entry>& entries() const;
+
+    private:
+        std::map<std::string, Entry>    _entries;
+        std::set<std::string>           _extraAllowed;
+        uint64                          _task {~uint64{}};
+        std::set<std::string>           _kept;
+    };
+}
@@ -6,11 +6,17 @@
    You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
 
 #include "storage.hpp"
+#include "metaPaths.hpp"
+#include "storage/sync.hpp"
+#include "storage/seek.hpp"
+#include "storage/compressed.hpp"
 #include <dci/aup/exception.hpp>
 #include <dci/utils/b2h.hpp>
 #include <dci/utils/h2b.hpp>
 #include <dci/utils/atScopeExit.hpp>
+#include <dci/crypto/rnd.hpp>
 #include <dci/logger.hpp>
+#include <cstring>
 
 namespace dci::aup::impl
 {
@@ -29,12 +35,26 @@ namespace dci::aup::impl
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     void Storage::reset()
     {
+        try
+        {
+            flush();
+        }
+        catch(...)
+        {
+            LOGW("unable to flush storage: "<<exception::currentToString());
+        }
+
+        _batch = false;
         _place.clear();
         _autoFixIfCan = true;
+        _packed = false;
+        _compressed = false;
+        _pack.close();
+        _loose.clear();
     }
 
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
-    void Storage::reset(const std::string &place, bool autoFixIfCan)
+    void Storage::reset(const std::string &place, bool autoFixIfCan, bool packed, bool compressed)
     {
         if(place.empty())
         {
@@ -42,23 +62,44 @@ namespace dci::aup::impl
             return;
         }
 
+        flush();
+        _batch = false;
+
         _place = fs::weakly_canonical(place);
         _autoFixIfCan = autoFixIfCan;
+        _packed = packed;
+        _compressed = compressed;
 
         if(_autoFixIfCan)
         {
             fs::create_directories(_place);
         }
+
+        //читается всегда, если есть, пишется только в упакованном режиме
+        _pack.open(_place / "pack", _autoFixIfCan);
+
+        rescan();
     }
 
     namespace
     {
         void enumerateContent(const fs::path& root, bool autoFixIfCan, const auto& f)
         {
-            for(const fs::directory_entry& de : fs::recursive_directory_iterator{root})
+            if(!fs::exists(root))
+            {
+                return;
+            }
+
+            for(fs::recursive_directory_iterator iter{root}; iter != fs::recursive_directory_iterator{}; ++iter)
             {
+                const fs::directory_entry& de = *iter;
+
                 if(!de.is_regular_file())
                 {
+                    if(!iter.depth() && "pack" == de.path().filename())
+                    {
+                        iter.disable_recursion_pending();
+                    }
                     continue;
                 }
 
@@ -68,7 +109,7 @@ namespace dci::aup::impl
                     oidTxt += part.string();
                 }
 
-                if("catalog" == oidTxt)
+                if(isMetaPath(oidTxt))
                 {
                     continue;
                 }
@@ -108,6 +149,31 @@ namespace dci::aup::impl
                 return;
             }
 
+            if(_packed)
+            {
+                std::FILE* in = fopen(de.path().string().c_str(), "rb");
+                if(!in)
+                {
+                    LOGW("unable to import storage entry: "<<de.path().string()<<": "<<std::error_code(errno, std::generic_category()).message());
+                    return;
+                }
+                utils::AtScopeExit se = {[&]{fclose(in);}};
+
+                //pack хранит объекты как есть, сжатое представление разворачивается
+                if(storage::Compressed::recognize(in))
+                {
+                    std::optional<Bytes> blob = from->get(oid);
+                    if(blob)
+                    {
+                        put(oid, std::move(*blob));
+                    }
+                    return;
+                }
+
+                put(oid, in);
+                return;
+            }
+
             fs::path path = filePath(oid);
             if(path.empty())
             {
@@ -117,8 +183,14 @@ namespace dci::aup::impl
 
             try
             {
-                fs::create_directories(path.parent_path());
+                if(fs::create_directories(path.parent_path()))
+                {
+                    _dirtyDirs.insert(_place);
+                }
                 fs::rename(de.path(), path);
+                _dirtyDirs.insert(path.parent_path());
+                _loose.insert(oid);
+                from->_loose.erase(oid);
             }
             catch(...)
             {
@@ -128,58 +200,210 @@ namespace dci::aup::impl
 
             //LOGI("imported storage entry: "<<de.path().string()<<" -> "<<path.string());
         });
+
+        for(const auto&[oid, location] : from->_pack.locations())
+        {
+            (void)location;
+
+            if(has(oid))
+            {
+                //already
+                continue;
+            }
+
+            std::optional<Bytes> blob = from->get(oid);
+            if(blob)
+            {
+                put(oid, std::move(*blob));
+            }
+        }
+
+        if(!_batch)
+        {
+            flush();
+        }
     }
 
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
-    uint32 Storage::dropOthersThan(const Set<Oid>& keep)
+    uint32 Storage::dropOthersThan(const OidInterner& oids, const HandleSet& keep)
     {
+        //незафиксированные временные файлы иначе будут приняты за мусор
+        flush();
+
         uint32 res{};
+        std::unordered_set<Oid, OidHash> loose;
         enumerateContent(_place, _autoFixIfCan, [&](const fs::directory_entry& de, const Oid& oid)
         {
-            if(!keep.count(oid))
+            if(!keep.count(oids.find(oid)))
             {
                 fs::remove(de.path());
                 res++;
             }
+            else
+            {
+                loose.insert(oid);
+            }
         });
+        _loose.swap(loose);
+
+        std::vector<Oid> packedGarbage;
+        for(const auto&[oid, location] : _pack.locations())
+        {
+            (void)location;
+
+            if(!keep.count(oids.find(oid)))
+            {
+                packedGarbage.push_back(oid);
+            }
+        }
+
+        try
+        {
+            for(const Oid& oid : packedGarbage)
+            {
+                _pack.del(oid);
+                res++;
+            }
+        }
+        catch(const std::system_error& e)
+        {
+            std::throw_with_nested(aup::Exception{"storage drop fail ("+e.code().message()+")"});
+        }
 
         return res;
     }
 
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    uint64 Storage::compact()
+    {
+        try
+        {
+            return _pack.compact();
+        }
+        catch(const std::system_error& e)
+        {
+            std::throw_with_nested(aup::Exception{"storage compact fail ("+e.code().message()+")"});
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Storage::batchBegin()
+    {
+        _batch = true;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Storage::batchCommit()
+    {
+        _batch = false;
+        flush();
+    }
+
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     Set<Oid> Storage::enumerate()
     {
-        Set<Oid> res;
-        enumerateContent(_place, _autoFixIfCan, [&](const fs::directory_entry&, const Oid& oid)
+        Set<Oid> res{_loose.begin(), _loose.end()};
+
+        for(const auto&[oid, location] : _pack.locations())
         {
+            (void)location;
             res.insert(oid);
-        });
+        }
 
         return res;
     }
 
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Storage::rescan()
+    {
+        _loose.clear();
+
+        if(_place.empty())
+        {
+            return;
+        }
+
+        enumerateContent(_place, _autoFixIfCan, [&](const fs::directory_entry&, const Oid& oid)
+        {
+            _loose.insert(oid);
+        });
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Storage::flush()
+    {
+        try
+        {
+            _pack.sync();
+
+            if(_pending.empty() && _dirtyDirs.empty())
+            {
+                return;
+            }
+
+            utils::AtScopeExit se = {[&]
+            {
+                _pending.clear();
+                _dirtyDirs.clear();
+            }};
+
+            //сначала содержимое, потом имена
+            for(const auto&[path, tmp] : _pending)
+            {
+                storage::syncFile(tmp);
+            }
+
+            for(const auto&[path, tmp] : _pending)
+            {
+                fs::rename(tmp, path);
+                _dirtyDirs.insert(path.parent_path());
+            }
+
+            for(const fs::path& dir : _dirtyDirs)
+            {
+                storage::syncDir(dir);
+            }
+        }
+        catch(const std::system_error& e)
+        {
+            std::throw_with_nested(aup::Exception{"storage flush fail ("+e.code().message()+")"});
+        }
+    }
+
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     void Storage::put(const std::string& localPath, Bytes&& blob)
     {
-        return put_(filePath(localPath), std::move(blob));
+        return put_(filePath(localPath), std::move(blob), false);
     }
 
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     void Storage::put(const std::string& localPath, std::FILE* f)
     {
-        return put_(filePath(localPath), f);
+        return put_(filePath(localPath), f, false);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Storage::append(const std::string& localPath, Bytes&& blob)
+    {
+        return append_(actualPath(filePath(localPath)), std::move(blob));
     }
 
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     bool Storage::has(const std::string& localPath)
     {
-        return has_(filePath(localPath));
+        return has_(actualPath(filePath(localPath)));
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    std::optional<Bytes> Storage::get(const std::string& localPath, uint64 offset, uint64 size)
+    {
+        return get_(actualPath(filePath(localPath)), offset, size);
     }
 
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
-    std::optional<Bytes> Storage::get(const std::string& localPath, uint32 offset, uint32 size)
+    std::optional<aup::storage::Mapping> Storage::map(const std::string& localPath)
     {
-        return get_(filePath(localPath), offset, size);
+        return map_(actualPath(filePath(localPath)));
     }
 
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
@@ -191,31 +415,193 @@ namespace dci::aup::impl
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     void Storage::put(const Oid& oid, Bytes&& blob)
     {
-        return put_(filePath(oid), std::move(blob));
+        if(_packed)
+        {
+            try
+            {
+                _pack.put(oid, std::move(blob));
+                if(!_batch)
+                {
+                    _pack.sync();
+                }
+                return;
+            }
+            catch(const std::system_error& e)
+            {
+                std::throw_with_nested(aup::Exception{"storage put fail ("+e.code().message()+")"});
+            }
+        }
+
+        fs::path path = filePath(oid);
+        put_(path, std::move(blob), _compressed);
+        if(!path.empty())
+        {
+            _loose.insert(oid);
+        }
     }
 
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     void Storage::put(const Oid& oid, std::FILE* f)
     {
-        return put_(filePath(oid), f);
+        if(_packed)
+        {
+            try
+            {
+                _pack.put(oid, f);
+                if(!_batch)
+                {
+                    _pack.sync();
+                }
+                return;
+            }
+            catch(const std::system_error& e)
+            {
+                std::throw_with_nested(aup::Exception{"storage put fail ("+e.code().message()+")"});
+            }
+        }
+
+        fs::path path = filePath(oid);
+        put_(path, f, _compressed);
+        if(!path.empty())
+        {
+            _loose.insert(oid);
+        }
     }
 
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     bool Storage::has(const Oid& oid)
     {
-        return has_(filePath(oid));
+        return _loose.count(oid) || _pack.locate(oid);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    std::optional<Bytes> Storage::get(const Oid& oid, uint64 offset, uint64 size)
+    {
+        if(_pack.locate(oid))
+        {
+            try
+            {
+                return _pack.get(oid, offset, size);
+            }
+            catch(const std::system_error& e)
+            {
+                std::throw_with_nested(aup::Exception{"storage get fail ("+e.code().message()+")"});
+            }
+        }
+
+        if(!_loose.count(oid))
+        {
+            return {};
+        }
+
+        std::optional<Bytes> res = get_(actualPath(filePath(oid)), offset, size);
+        if(!res)
+        {
+            //пропал из-под ног
+            _loose.erase(oid);
+        }
+
+        return res;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    std::optional<aup::storage::Mapping> Storage::map(const Oid& oid)
+    {
+        if(_pack.locate(oid))
+        {
+            try
+            {
+                return _pack.map(oid);
+            }
+            catch(const std::system_error& e)
+            {
+                std::throw_with_nested(aup::Exception{"storage map fail ("+e.code().message()+")"});
+            }
+        }
+
+        if(!_loose.count(oid))
+        {
+            return {};
+        }
+
+        std::optional<aup::storage::Mapping> res = map_(actualPath(filePath(oid)));
+        if(!res)
+        {
+            //пропал из-под ног
+            _loose.erase(oid);
+        }
+
+        return res;
     }
 
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
-    std::optional<Bytes> Storage::get(const Oid& oid, uint32 offset, uint32 size)
+    std::optional<Storage::Placement> Storage::placement(const Oid& oid)
     {
-        return get_(filePath(oid), offset, size);
+        if(const storage::Pack::Location* location = _pack.locate(oid))
+        {
+            return Placement{_pack.packPath(location->_pack), location->_offset, location->_size};
+        }
+
+        if(!_loose.count(oid))
+        {
+            return {};
+        }
+
+        try
+        {
+            fs::path path = actualPath(filePath(oid));
+
+            std::FILE* in = fopen(path.string().c_str(), "rb");
+            if(!in)
+            {
+                //пропал из-под ног
+                _loose.erase(oid);
+                return {};
+            }
+            utils::AtScopeExit se = {[&]{fclose(in);}};
+
+            if(storage::Compressed::recognize(in))
+            {
+                return Placement{std::move(path), 0, storage::Compressed{in}.size(), true};
+            }
+
+            std::error_code ec;
+            uint64 size = fs::file_size(path, ec);
+            if(ec)
+            {
+                //пропал из-под ног
+                _loose.erase(oid);
+                return {};
+            }
+
+            return Placement{std::move(path), 0, size};
+        }
+        catch(const std::system_error& e)
+        {
+            std::throw_with_nested(aup::Exception{"storage placement fail ("+e.code().message()+")"});
+        }
     }
 
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     bool Storage::del(const Oid& oid)
     {
-        return del_(filePath(oid));
+        bool res = false;
+
+        try
+        {
+            res = _pack.del(oid);
+        }
+        catch(const std::system_error& e)
+        {
+            std::throw_with_nested(aup::Exception{"storage del fail ("+e.code().message()+")"});
+        }
+
+        if(_loose.erase(oid))
+        {
+            res = del_(filePath(oid)) || res;
+        }
+
+        return res;
     }
 
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
@@ -226,6 +612,11 @@ namespace dci::aup::impl
             return;
         }
 
+        _pack.close();
+        _loose.clear();
+        _pending.clear();
+        _dirtyDirs.clear();
+
         try
         {
             if(andPlaceDirectory)
@@ -244,71 +635,132 @@ namespace dci::aup::impl
         {
             std::throw_with_nested(aup::Exception{"storage delAll fail: "+e.code().message()});
         }
+
+        _pack.open(_place / "pack", _autoFixIfCan);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    std::FILE* Storage::tmpFile()
+    {
+        if(_place.empty())
+        {
+            throw aup::Exception{"storage tmp file fail (no place)"};
+        }
+
+        char rnd[16];
+        crypto::rnd::generate(rnd, sizeof(rnd));
+        fs::path path = _place / (utils::b2h(rnd, sizeof(rnd)) + ".tmp");
+
+#ifdef _WIN32
+        std::FILE* res = fopen(path.string().c_str(), "w+bTD");
+#else
+        std::FILE* res = fopen(path.string().c_str(), "w+b");
+#endif
+        if(!res)
+        {
+            std::error_code ec{errno, std::generic_category()};
+            throw aup::Exception{"storage tmp file fail ("+ec.message()+")"};
+        }
+
+#ifndef _WIN32
+        //открытый файл живет и без имени
+        std::error_code ec;
+        fs::remove(path, ec);
+#endif
+
+        return res;
     }
 
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
-    void Storage::put_(const fs::path& path, Bytes&& blob_)
+    void Storage::put_(const fs::path& path, Bytes&& blob_, bool compress)
     {
         if(path.empty())
         {
             return;
         }
 
+        fs::path tmp = path;
+        tmp += ".tmp";
+
         try
         {
             Bytes blob {std::move(blob_)};
-            fs::create_directories(path.parent_path());
+            bool newDir = fs::create_directories(path.parent_path());
 
             {
-                std::FILE* out = fopen(path.string().c_str(), "wb");
+                std::FILE* out = fopen(tmp.string().c_str(), "wb");
                 if(!out)
                 {
-                    throw std::system_error(errno, std::generic_category(), "unable to open "+path.string());
+                    throw std::system_error(errno, std::generic_category(), "unable to open "+tmp.string());
                 }
                 utils::AtScopeExit se{[&]{fclose(out);}};
 
-                bytes::Cursor c {blob.begin()};
-                while(!c.atEnd())
+                if(!storage::Compressed::pack(blob, out, compress))
                 {
-                    uint32 s = c.continuousDataSize();
-                    if(s != fwrite(c.continuousData(), 1, s, out))
+                    bytes::Cursor c {blob.begin()};
+                    while(!c.atEnd())
                     {
-                        throw std::system_error(errno, std::generic_category(), "unable to write "+path.string());
+                        uint32 s = c.continuousDataSize();
+                        if(s != fwrite(c.continuousData(), 1, s, out))
+                        {
+                            throw std::system_error(errno, std::generic_category(), "unable to write "+tmp.string());
+                        }
+
+                        c.advanceChunks(1);
                     }
+                }
 
-                    c.advanceChunks(1);
+                if(_batch)
+                {
+                    if(fflush(out))
+                    {
+                        throw std::system_error(errno, std::generic_category(), "unable to write "+tmp.string());
+                    }
+                }
+                else
+                {
+                    storage::syncFile(out, tmp);
                 }
             }
+
+            place_(path, tmp, newDir);
         }
         catch(const std::system_error& e)
         {
+            std::error_code ec;
+            fs::remove(tmp, ec);
             std::throw_with_nested(aup::Exception{"storage put fail ("+e.code().message()+")"});
         }
     }
 
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
-    void Storage::put_(const std::filesystem::path& path, std::FILE* f)
+    void Storage::put_(const std::filesystem::path& path, std::FILE* f, bool compress)
     {
         if(path.empty())
         {
             return;
         }
 
+        fs::path tmp = path;
+        tmp += ".tmp";
+
         try
         {
-            fs::create_directories(path.parent_path());
+            bool newDir = fs::create_directories(path.parent_path());
 
             {
-                std::FILE* out = fopen(path.string().c_str(), "wb");
+                std::FILE* out = fopen(tmp.string().c_str(), "wb");
                 if(!out)
                 {
-                    throw std::system_error(errno, std::generic_category(), "unable to open "+path.string());
+                    throw std::system_error(errno, std::generic_category(), "unable to open "+tmp.string());
                 }
                 utils::AtScopeExit se = {[&]{fclose(out);}};
 
+                bool packed = storage::Compressed::pack(f, out, compress);
+
                 rewind(f);
                 char buf[1024];
-                for(;;)
+                while(!packed)
                 {
                     std::size_t s = fread(buf, 1, sizeof(buf), f);
                     if(!s)
@@ -318,7 +770,7 @@ namespace dci::aup::impl
 
                     if(s != fwrite(buf, 1, s, out))
                     {
-                        throw std::system_error(errno, std::generic_category(), "unable to write "+path.string());
+                        throw std::system_error(errno, std::generic_category(), "unable to write "+tmp.string());
                     }
 
                     if(s != sizeof(buf))
@@ -326,14 +778,82 @@ namespace dci::aup::impl
                         break;
                     }
                 }
+
+                if(_batch)
+                {
+                    if(fflush(out))
+                    {
+                        throw std::system_error(errno, std::generic_category(), "unable to write "+tmp.string());
+                    }
+                }
+                else
+                {
+                    storage::syncFile(out, tmp);
+                }
             }
+
+            place_(path, tmp, newDir);
         }
         catch(const std::system_error& e)
         {
+            std::error_code ec;
+            fs::remove(tmp, ec);
             std::throw_with_nested(aup::Exception{"storage put fail ("+e.code().message()+")"});
         }
     }
 
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Storage::append_(const fs::path& path, Bytes&& blob_)
+    {
+        if(path.empty())
+        {
+            return;
+        }
+
+        try
+        {
+            Bytes blob {std::move(blob_)};
+            bool newDir = fs::create_directories(path.parent_path());
+            bool newFile = !fs::exists(path);
+
+            std::FILE* out = fopen(path.string().c_str(), "ab");
+            if(!out)
+            {
+                throw std::system_error(errno, std::generic_category(), "unable to open "+path.string());
+            }
+            utils::AtScopeExit se{[&]{fclose(out);}};
+
+            bytes::Cursor c {blob.begin()};
+            while(!c.atEnd())
+            {
+                uint32 s = c.continuousDataSize();
+                if(s != fwrite(c.continuousData(), 1, s, out))
+                {
+                    throw std::system_error(errno, std::generic_category(), "unable to write "+path.string());
+                }
+
+                c.advanceChunks(1);
+            }
+
+            //дописывание не атомарно, оборванный хвост должен распознавать читатель
+            storage::syncFile(out, path);
+
+            if(newDir)
+            {
+                storage::syncDir(path.parent_path().parent_path());
+            }
+
+            if(newFile)
+            {
+                storage::syncDir(path.parent_path());
+            }
+        }
+        catch(const std::system_error& e)
+        {
+            std::throw_with_nested(aup::Exception{"storage append fail ("+e.code().message()+")"});
+        }
+    }
+
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     bool Storage::has_(const fs::path& path)
     {
@@ -360,7 +880,7 @@ namespace dci::aup::impl
     }
 
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
-    std::optional<Bytes> Storage::get_(const fs::path& path, uint32 offset, uint32 size)
+    std::optional<Bytes> Storage::get_(const fs::path& path, uint64 offset, uint64 size)
     {
         if(path.empty())
         {
@@ -393,16 +913,30 @@ namespace dci::aup::impl
                 }
                 utils::AtScopeExit se = {[&]{fclose(in);}};
 
-                if(fseek(in, offset, SEEK_SET))
+                bytes::Alter a {blob.end()};
+
+                if(storage::Compressed::recognize(in))
+                {
+                    //только кадры, покрывающие диапазон
+                    storage::Compressed{in}.unpack(offset, size, [&](const uint8* data, uint64 amount)
+                    {
+                        a.write(data, static_cast<uint32>(amount));
+                    });
+                    size = 0;
+                }
+                else if(storage::seek(in, offset))
                 {
                     throw std::system_error(errno, std::generic_category(), "unable to seek "+path.string());
                 }
 
-                bytes::Alter a {blob.end()};
                 while(size)
                 {
                     uint32 bufSize;
                     void* buf = a.prepareWriteBuffer(bufSize);
+                    if(bufSize > size)
+                    {
+                        bufSize = static_cast<uint32>(size);
+                    }
 
                     uint32 s = static_cast<uint32>(fread(buf, 1, bufSize, in));
                     if(!s)
@@ -428,6 +962,63 @@ namespace dci::aup::impl
         }
     }
 
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    std::optional<aup::storage::Mapping> Storage::map_(const fs::path& path)
+    {
+        if(path.empty())
+        {
+            return {};
+        }
+
+        try
+        {
+            if(!fs::exists(path))
+            {
+                return {};
+            }
+
+            if(!fs::is_regular_file(path))
+            {
+                if(_autoFixIfCan)
+                {
+                    fs::remove_all(path);
+                }
+                return {};
+            }
+
+            aup::storage::Mapping res;
+
+            {
+                std::FILE* in = fopen(path.string().c_str(), "rb");
+                if(!in)
+                {
+                    throw std::system_error(errno, std::generic_category(), "unable to open "+path.string());
+                }
+                utils::AtScopeExit se = {[&]{fclose(in);}};
+
+                if(storage::Compressed::recognize(in))
+                {
+                    //сжатое представление разворачивается в собственный буфер
+                    storage::Compressed c{in};
+                    uint8* dst = res.allocate(c.size());
+                    c.unpack(0, c.size(), [&](const uint8* data, uint64 amount)
+                    {
+                        std::memcpy(dst, data, amount);
+                        dst += amount;
+                    });
+                    return {std::move(res)};
+                }
+            }
+
+            res.open(path);
+            return {std::move(res)};
+        }
+        catch(const std::system_error& e)
+        {
+            std::throw_with_nested(aup::Exception{"storage map fail ("+e.code().message()+")"});
+        }
+    }
+
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     bool Storage::del_(const fs::path& path)
     {
@@ -438,7 +1029,16 @@ namespace dci::aup::impl
 
         try
         {
-            if(!fs::remove_all(path))
+            bool pending = false;
+            auto iter = _pending.find(path);
+            if(_pending.end() != iter)
+            {
+                fs::remove(iter->second);
+                _pending.erase(iter);
+                pending = true;
+            }
+
+            if(!fs::remove_all(path) && !pending)
             {
                 return false;
             }
@@ -469,6 +1069,38 @@ namespace dci::aup::impl
         }
     }
 
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Storage::place_(const fs::path& path, const fs::path& tmp, bool newDir)
+    {
+        if(newDir)
+        {
+            _dirtyDirs.insert(path.parent_path().parent_path());
+        }
+
+        if(_batch)
+        {
+            _pending[path] = tmp;
+            return;
+        }
+
+        _pending.erase(path);
+        fs::rename(tmp, path);
+        _dirtyDirs.insert(path.parent_path());
+
+        for(const fs::path& dir : _dirtyDirs)
+        {
+            storage::syncDir(dir);
+        }
+        _dirtyDirs.clear();
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    const fs::path& Storage::actualPath(const fs::path& path) const
+    {
+        auto iter = _pending.find(path);
+        return _pending.end() == iter ? path : iter->second;
+    }
+
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     fs::path Storage::filePath(const std::string& localPath)
     {
@@ -9,8 +9,14 @@
 
 #include <dci/bytes.hpp>
 #include <dci/aup/oid.hpp>
+#include "storage/pack.hpp"
+#include "oidHash.hpp"
+#include "oidInterner.hpp"
 #include <optional>
 #include <filesystem>
+#include <unordered_set>
+#include <map>
+#include <set>
 
 namespace dci::aup::impl
 {
@@ -22,16 +28,30 @@ namespace dci::aup::impl
         void operator=(const Storage&) = delete;
         void operator=(Storage&&) = delete;
 
+    public:
+        //физическое расположение объекта: файл и диапазон в нем, либо весь файл в сжатом представлении
+        struct Placement
+        {
+            std::filesystem::path   _path;
+            uint64                  _offset {};
+            uint64                  _size {};
+            bool                    _compressed {};
+        };
+
     public:
         Storage();
         ~Storage();
 
         void reset();
-        void reset(const std::string& place, bool autoFixIfCan=true);
+        void reset(const std::string& place, bool autoFixIfCan=true, bool packed=false, bool compressed=false);
 
         void import(Storage* from);
 
-        uint32 dropOthersThan(const Set<Oid>& keep);
+        uint32 dropOthersThan(const OidInterner& oids, const HandleSet& keep);
+        uint64 compact();
+
+        void batchBegin();
+        void batchCommit();
 
     public:
         Set<Oid> enumerate();
@@ -39,30 +59,56 @@ namespace dci::aup::impl
     public:
         void put(const std::string& localPath, Bytes&& blob);
         void put(const std::string& localPath, std::FILE* f);
+        void append(const std::string& localPath, Bytes&& blob);
         bool has(const std::string& localPath);
-        std::optional<Bytes> get(const std::string& localPath, uint32 offset=0, uint32 size=~uint32{0});
+        std::optional<Bytes> get(const std::string& localPath, uint64 offset=0, uint64 size=~uint64{0});
+        std::optional<aup::storage::Mapping> map(const std::string& localPath);
         bool del(const std::string& localPath);
 
         void put(const Oid& oid, Bytes&& blob);
         void put(const Oid& oid, std::FILE* f);
         bool has(const Oid& oid);
-        std::optional<Bytes> get(const Oid& oid, uint32 offset=0, uint32 size=~uint32{0});
+        std::optional<Bytes> get(const Oid& oid, uint64 offset=0, uint64 size=~uint64{0});
+        std::optional<aup::storage::Mapping> map(const Oid& oid);
+        std::optional<Placement> placement(const Oid& oid);
         bool del(const Oid& oid);
 
         void delAll(bool andPlaceDirectory);
 
+        //безымянный временный файл на той же фс, исчезает при закрытии
+        std::FILE* tmpFile();
+
     private:
-        void put_(const std::filesystem::path& path, Bytes&& blob);
-        void put_(const std::filesystem::path& path, std::FILE* f);
+        void rescan();
+        void flush();
+
+        void put_(const std::filesystem::path& path, Bytes&& blob, bool compress);
+        void put_(const std::filesystem::path& path, std::FILE* f, bool compress);
+        void append_(const std::filesystem::path& path, Bytes&& blob);
         bool has_(const std::filesystem::path& path);
-        std::optional<Bytes> get_(const std::filesystem::path& path, uint32 offset=0, uint32 size=~uint32{0});
+        std::optional<Bytes> get_(const std::filesystem::path& path, uint64 offset=0, uint64 size=~uint64{0});
+        std::optional<aup::storage::Mapping> map_(const std::filesystem::path& path);
         bool del_(const std::filesystem::path& path);
 
+        void place_(const std::filesystem::path& path, const std::filesystem::path& tmp, bool newDir);
+        const std::filesystem::path& actualPath(const std::filesystem::path& path) const;
+
         std::filesystem::path filePath(const std::string& localPath);
         std::filesystem::path filePath(const Oid& oid);
 
     private:
         std::filesystem::path _place;
         bool _autoFixIfCan{true};
+        bool _packed{false};
+        bool _compressed{false};
+        storage::Pack _pack;
+
+        //поштучно лежащие объекты, строится при reset, чтобы has/get не ходили в файловую систему за отсутствующими
+        std::unordered_set<Oid, OidHash> _loose;
+
+        //групповая фиксация: файлы пишутся во временные, переименовываются и сбрасываются на носитель разом в flush
+        bool _batch{false};
+        std::map<std::filesystem::path, std::filesystem::path> _pending;
+        std::set<std::filesystem::path> _dirtyDirs;
     };
 }
@@ -0,0 +1,285 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+
+#include "compressed.hpp"
+#include "seek.hpp"
+#include <dci/utils/atScopeExit.hpp>
+#include <cstring>
+#include <system_error>
+
+#ifdef DCI_AUP_ZSTD
+#   include <zstd.h>
+#endif
+
+namespace dci::aup::impl::storage
+{
+    namespace
+    {
+        constexpr uint64 g_magic = 0x7a63d59e1b0f48a2;
+
+        //magic, size, frame, count
+        constexpr uint64 g_headerSize = 4 * sizeof(uint64);
+
+        constexpr uint64 g_frame = uint64{256} * 1024;
+        constexpr int g_level = 3;
+
+        /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+        std::size_t frameBound()
+        {
+#ifdef DCI_AUP_ZSTD
+            return ZSTD_compressBound(g_frame);
+#else
+            return g_frame;
+#endif
+        }
+
+        /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+        //размер сжатого кадра в packed, либо amount - кадр хранится как есть
+        uint64 packFrame(const uint8* frame, uint64 amount, std::vector<uint8>& packed)
+        {
+#ifdef DCI_AUP_ZSTD
+            std::size_t r = ZSTD_compress(packed.data(), packed.size(), frame, amount, g_level);
+            if(!ZSTD_isError(r) && r < amount)
+            {
+                return r;
+            }
+#else
+            (void)frame;
+            (void)packed;
+#endif
+            return amount;
+        }
+
+        /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+        void write(std::FILE* out, const void* data, uint64 size)
+        {
+            if(size != fwrite(data, 1, size, out))
+            {
+                throw std::system_error(errno, std::generic_category(), "unable to write compressed object");
+            }
+        }
+
+        /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+        bool packFrom(uint64 size, const std::function<void(uint8*, uint64)>& read, std::FILE* out, bool wanted)
+        {
+            std::vector<uint8> frame(g_frame);
+
+            uint64 magic{};
+            uint64 amount = std::min<uint64>(size, sizeof(magic));
+            read(frame.data(), amount);
+
+            std::memcpy(&magic, frame.data(), amount);
+            bool force = sizeof(magic) == amount && g_magic == magic;
+            if(!force && !wanted)
+            {
+                return false;
+            }
+
+            read(frame.data() + amount, std::min(size, g_frame) - amount);
+            amount = std::min(size, g_frame);
+
+            std::vector<uint8> packed(frameBound());
+            uint64 packedSize = packFrame(frame.data(), amount, packed);
+            if(!force && (!amount || packedSize * 10 > amount * 9))
+            {
+                return false;
+            }
+
+            uint64 count = (size + g_frame - 1) / g_frame;
+            uint64 header[4] = {g_magic, size, g_frame, count};
+            write(out, header, sizeof(header));
+
+            std::vector<uint64> offsets(count + 1);
+            uint64 tablePos = tell(out);
+            write(out, offsets.data(), offsets.size() * sizeof(uint64));
+
+            for(uint64 index{}; index < count; ++index)
+            {
+                if(index)
+                {
+                    amount = std::min(size - index * g_frame, g_frame);
+                    read(frame.data(), amount);
+                    packedSize = packFrame(frame.data(), amount, packed);
+                }
+
+                write(out, packedSize == amount ? frame.data() : packed.data(), packedSize);
+                offsets[index + 1] = offsets[index] + packedSize;
+            }
+
+            if(seek(out, tablePos))
+            {
+                throw std::system_error(errno, std::generic_category(), "unable to seek compressed object");
+            }
+            write(out, offsets.data(), offsets.size() * sizeof(uint64));
+
+            if(seek(out, tablePos + offsets.size() * sizeof(uint64) + offsets.back()))
+            {
+                throw std::system_error(errno, std::generic_category(), "unable to seek compressed object");
+            }
+
+            return true;
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    bool Compressed::recognize(std::FILE* in)
+    {
+        uint64 magic{};
+        return !seek(in, 0) && sizeof(magic) == fread(&magic, 1, sizeof(magic), in) && g_magic == magic;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    bool Compressed::pack(const Bytes& blob, std::FILE* out, bool wanted)
+    {
+        bytes::Cursor c{blob.begin()};
+        return packFrom(blob.size(), [&](uint8* dst, uint64 amount)
+        {
+            c.read(dst, static_cast<uint32>(amount));
+        }, out, wanted);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    bool Compressed::pack(std::FILE* in, std::FILE* out, bool wanted)
+    {
+        if(fseek(in, 0, SEEK_END))
+        {
+            throw std::system_error(errno, std::generic_category(), "unable to seek source object");
+        }
+        uint64 size = tell(in);
+        rewind(in);
+
+        bool res = packFrom(size, [&](uint8* dst, uint64 amount)
+        {
+            if(amount != fread(dst, 1, amount, in))
+            {
+                throw std::system_error(ferror(in) ? errno : EIO, std::generic_category(), "unable to read source object");
+            }
+        }, out, wanted);
+
+        rewind(in);
+        return res;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Compressed::extract(const std::filesystem::path& src, const std::filesystem::path& dst)
+    {
+        std::FILE* in = fopen(src.string().c_str(), "rb");
+        if(!in)
+        {
+            throw std::system_error(errno, std::generic_category(), "unable to open "+src.string());
+        }
+        utils::AtScopeExit inCloser{[&]{fclose(in);}};
+
+        std::FILE* out = fopen(dst.string().c_str(), "wb");
+        if(!out)
+        {
+            throw std::system_error(errno, std::generic_category(), "unable to open "+dst.string());
+        }
+        utils::AtScopeExit outCloser{[&]{fclose(out);}};
+
+        Compressed c{in};
+        c.unpack(0, c.size(), [&](const uint8* data, uint64 size)
+        {
+            if(size != fwrite(data, 1, size, out))
+            {
+                throw std::system_error(errno, std::generic_category(), "unable to write "+dst.string());
+            }
+        });
+
+        if(fflush(out))
+        {
+            throw std::system_error(errno, std::generic_category(), "unable to write "+dst.string());
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    Compressed::Compressed(std::FILE* in)
+        : _in{in}
+    {
+        uint64 header[4];
+        if(seek(_in, 0) || sizeof(header) != fread(header, 1, sizeof(header), _in))
+        {
+            throw std::system_error(EIO, std::generic_category(), "unable to read compressed object header");
+        }
+
+        _size = header[1];
+        _frame = header[2];
+
+        if(g_magic != header[0] || !_frame || _frame > g_frame || header[3] != (_size + _frame - 1) / _frame)
+        {
+            throw std::system_error(EIO, std::generic_category(), "bad compressed object header");
+        }
+
+        _offsets.resize(header[3] + 1);
+        if(_offsets.size() * sizeof(uint64) != fread(_offsets.data(), 1, _offsets.size() * sizeof(uint64), _in))
+        {
+            throw std::system_error(EIO, std::generic_category(), "unable to read compressed object table");
+        }
+
+        for(std::size_t index{}; index + 1 < _offsets.size(); ++index)
+        {
+            if(_offsets[index] > _offsets[index + 1] || _offsets[index + 1] - _offsets[index] > _frame)
+            {
+                throw std::system_error(EIO, std::generic_category(), "bad compressed object table");
+            }
+        }
+
+        _dataStart = g_headerSize + _offsets.size() * sizeof(uint64);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    uint64 Compressed::size() const
+    {
+        return _size;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Compressed::unpack(uint64 offset, uint64 size, const std::function<void(const uint8*, uint64)>& sink)
+    {
+        if(offset > _size) offset = _size;
+        if(size > _size - offset) size = _size - offset;
+
+        std::vector<uint8> packed;
+        std::vector<uint8> frame;
+
+        for(uint64 index = offset / _frame; size; ++index)
+        {
+            uint64 frameStart = index * _frame;
+            uint64 frameSize = std::min(_frame, _size - frameStart);
+            uint64 packedSize = _offsets[index + 1] - _offsets[index];
+
+            packed.resize(packedSize);
+            if(seek(_in, _dataStart + _offsets[index]) || packedSize != fread(packed.data(), 1, packedSize, _in))
+            {
+                throw std::system_error(EIO, std::generic_category(), "unable to read compressed object frame");
+            }
+
+            const uint8* data = packed.data();
+            if(packedSize != frameSize)
+            {
+#ifdef DCI_AUP_ZSTD
+                frame.resize(frameSize);
+                std::size_t r = ZSTD_decompress(frame.data(), frame.size(), packed.data(), packed.size());
+                if(ZSTD_isError(r) || r != frameSize)
+                {
+                    throw std::system_error(EIO, std::generic_category(), "unable to decompress object frame");
+                }
+                data = frame.data();
+#else
+                throw std::system_error(ENOTSUP, std::generic_category(), "compressed objects are not supported");
+#endif
+            }
+
+            uint64 begin = offset > frameStart ? offset - frameStart : 0;
+            uint64 amount = std::min(frameSize - begin, size);
+            sink(data + begin, amount);
+
+            size -= amount;
+        }
+    }
+}
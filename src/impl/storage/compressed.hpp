@@ -0,0 +1,56 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+
+#pragma once
+
+#include <dci/primitives.hpp>
+#include <dci/bytes.hpp>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <vector>
+
+namespace dci::aup::impl::storage
+{
+    /* сжатое представление объекта хранилища
+     *
+     * заголовок: magic, исходный размер, размер кадра, количество кадров; далее таблица смещений кадров и сами кадры
+     * кадры независимы, диапазон читается разжатием только покрывающих его кадров
+     * кадр, не уменьшившийся при сжатии, хранится как есть
+     *
+     * ошибки - std::system_error
+     */
+    class Compressed final
+    {
+    public:
+        //по заголовку, позиция in не сохраняется
+        static bool recognize(std::FILE* in);
+
+        /* false - сжатие не нужно (wanted не взведен) или содержимое несжимаемо (по первому кадру), в out ничего не записано
+         * содержимое, начинающееся как заголовок, упаковывается всегда - иначе его не отличить
+         */
+        static bool pack(const Bytes& blob, std::FILE* out, bool wanted);
+        static bool pack(std::FILE* in, std::FILE* out, bool wanted);
+
+        //разжатие целиком в новый файл
+        static void extract(const std::filesystem::path& src, const std::filesystem::path& dst);
+
+    public:
+        explicit Compressed(std::FILE* in);
+
+        uint64 size() const;
+        void unpack(uint64 offset, uint64 size, const std::function<void(const uint8*, uint64)>& sink);
+
+    private:
+        std::FILE*          _in;
+        uint64              _size {};
+        uint64              _frame {};
+        uint64              _dataStart {};
+        std::vector<uint64> _offsets;
+    };
+}
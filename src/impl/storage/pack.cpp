@@ -0,0 +1,646 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+#include "pack.hpp"
+#include "sync.hpp"
+#include "seek.hpp"
+#include <dci/utils/atScopeExit.hpp>
+#include <dci/logger.hpp>
+#include <charconv>
+#include <cstring>
+
+namespace dci::aup::impl::storage
+{
+    namespace fs = std::filesystem;
+
+    namespace
+    {
+        //pack-файл перестает пополняться после достижения этого размера
+        constexpr uint64 g_maxPackSize = uint64{1} << 30;
+
+        //запись индекса: oid, pack, offset, size
+        constexpr std::size_t g_recordSize = sizeof(Oid) + sizeof(uint32) + sizeof(uint64) + sizeof(uint64);
+
+        //size надгробия
+        constexpr uint64 g_tombstone = ~uint64{};
+
+        void encode(uint8* rec, const Oid& oid, const Pack::Location& location)
+        {
+            std::memcpy(rec, oid.data(), oid.size());                   rec += oid.size();
+            std::memcpy(rec, &location._pack, sizeof(location._pack));  rec += sizeof(location._pack);
+            std::memcpy(rec, &location._offset, sizeof(location._offset));rec += sizeof(location._offset);
+            std::memcpy(rec, &location._size, sizeof(location._size));
+        }
+
+        void decode(const uint8* rec, Oid& oid, Pack::Location& location)
+        {
+            std::memcpy(oid.data(), rec, oid.size());                   rec += oid.size();
+            std::memcpy(&location._pack, rec, sizeof(location._pack));  rec += sizeof(location._pack);
+            std::memcpy(&location._offset, rec, sizeof(location._offset));rec += sizeof(location._offset);
+            std::memcpy(&location._size, rec, sizeof(location._size));
+        }
+
+        uint64 write(std::FILE* out, const Bytes& blob, const fs::path& path)
+        {
+            uint64 res{};
+
+            bytes::Cursor c {blob.begin()};
+            while(!c.atEnd())
+            {
+                uint32 s = c.continuousDataSize();
+                if(s != fwrite(c.continuousData(), 1, s, out))
+                {
+                    throw std::system_error(errno, std::generic_category(), "unable to write "+path.string());
+                }
+
+                res += s;
+                c.advanceChunks(1);
+            }
+
+            return res;
+        }
+
+        uint64 write(std::FILE* out, std::FILE* f, const fs::path& path)
+        {
+            uint64 res{};
+
+            rewind(f);
+            char buf[1024*64];
+            for(;;)
+            {
+                std::size_t s = fread(buf, 1, sizeof(buf), f);
+                if(!s)
+                {
+                    break;
+                }
+
+                if(s != fwrite(buf, 1, s, out))
+                {
+                    throw std::system_error(errno, std::generic_category(), "unable to write "+path.string());
+                }
+
+                res += s;
+
+                if(s != sizeof(buf))
+                {
+                    break;
+                }
+            }
+
+            return res;
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    Pack::Pack()
+    {
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    Pack::~Pack()
+    {
+        close();
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Pack::open(const fs::path& dir, bool autoFixIfCan)
+    {
+        close();
+
+        _dir = dir;
+        _autoFixIfCan = autoFixIfCan;
+
+        loadIndex();
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Pack::close()
+    {
+        closeFiles();
+
+        _dir.clear();
+        _autoFixIfCan = true;
+        _locations.clear();
+        _packStats.clear();
+        _indexRecords = 0;
+        _current = 0;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    const Pack::Locations& Pack::locations() const
+    {
+        return _locations;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    const Pack::Location* Pack::locate(const Oid& oid) const
+    {
+        auto iter = _locations.find(oid);
+        if(_locations.end() == iter)
+        {
+            return nullptr;
+        }
+
+        return &iter->second;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Pack::put(const Oid& oid, Bytes&& blob_)
+    {
+        if(_dir.empty() || _locations.count(oid))
+        {
+            return;
+        }
+
+        Bytes blob {std::move(blob_)};
+
+        Location location;
+        std::FILE* out = packForAppend(location);
+        try
+        {
+            location._size = write(out, blob, packPath(location._pack));
+        }
+        catch(...)
+        {
+            abandonCurrent();
+            throw;
+        }
+        commitAppended(oid, location);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Pack::put(const Oid& oid, std::FILE* f)
+    {
+        if(_dir.empty() || _locations.count(oid))
+        {
+            return;
+        }
+
+        Location location;
+        std::FILE* out = packForAppend(location);
+        try
+        {
+            location._size = write(out, f, packPath(location._pack));
+        }
+        catch(...)
+        {
+            abandonCurrent();
+            throw;
+        }
+        commitAppended(oid, location);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    std::optional<Bytes> Pack::get(const Oid& oid, uint64 offset, uint64 size)
+    {
+        const Location* location = locate(oid);
+        if(!location)
+        {
+            return {};
+        }
+
+        uint64 tail = location->_size > offset ? location->_size - offset : 0;
+        if(size > tail)
+        {
+            size = tail;
+        }
+
+        fs::path path = packPath(location->_pack);
+
+        std::FILE* in = fopen(path.string().c_str(), "rb");
+        if(!in)
+        {
+            throw std::system_error(errno, std::generic_category(), "unable to open "+path.string());
+        }
+        utils::AtScopeExit se = {[&]{fclose(in);}};
+
+        if(seek(in, location->_offset + offset))
+        {
+            throw std::system_error(errno, std::generic_category(), "unable to seek "+path.string());
+        }
+
+        Bytes blob;
+
+        bytes::Alter a {blob.end()};
+        while(size)
+        {
+            uint32 bufSize;
+            void* buf = a.prepareWriteBuffer(bufSize);
+            if(bufSize > size)
+            {
+                bufSize = static_cast<uint32>(size);
+            }
+
+            uint32 s = static_cast<uint32>(fread(buf, 1, bufSize, in));
+            a.commitWriteBuffer(s);
+
+            if(s != bufSize)
+            {
+                throw std::system_error(errno ? errno : EIO, std::generic_category(), "unable to read "+path.string());
+            }
+
+            size -= s;
+        }
+
+        return {std::move(blob)};
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    std::optional<aup::storage::Mapping> Pack::map(const Oid& oid)
+    {
+        const Location* location = locate(oid);
+        if(!location)
+        {
+            return {};
+        }
+
+        aup::storage::Mapping res;
+        res.open(packPath(location->_pack), location->_offset, location->_size);
+
+        if(res.size() != location->_size)
+        {
+            throw std::system_error(EIO, std::generic_category(), "unable to read "+packPath(location->_pack).string());
+        }
+
+        return {std::move(res)};
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    bool Pack::del(const Oid& oid)
+    {
+        auto iter = _locations.find(oid);
+        if(_locations.end() == iter)
+        {
+            return false;
+        }
+
+        appendIndex(oid, Location{0, 0, g_tombstone});
+
+        _packStats[iter->second._pack]._live -= iter->second._size;
+        _locations.erase(iter);
+
+        return true;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    uint64 Pack::compact()
+    {
+        if(_dir.empty())
+        {
+            return 0;
+        }
+
+        //pack-файлы, в которых мусор занимает не менее четверти
+        std::set<uint32> victims;
+        for(const auto&[pack, stat] : _packStats)
+        {
+            uint64 garbage = stat._total - std::min(stat._total, stat._live);
+            if(garbage && garbage >= stat._total/4)
+            {
+                victims.insert(pack);
+            }
+        }
+
+        if(victims.empty() && _indexRecords <= _locations.size()*2)
+        {
+            return 0;
+        }
+
+        if(!victims.empty())
+        {
+            //живые объекты переезжают в новый pack-файл
+            closeFiles();
+            _current = _packStats.rbegin()->first + 1;
+
+            for(auto&[oid, location] : _locations)
+            {
+                if(!victims.count(location._pack))
+                {
+                    continue;
+                }
+
+                std::optional<Bytes> blob = get(oid);
+                if(!blob)
+                {
+                    continue;
+                }
+
+                Location moved;
+                std::FILE* out = packForAppend(moved);
+                moved._size = write(out, *blob, packPath(moved._pack));
+                if(fflush(out))
+                {
+                    throw std::system_error(errno, std::generic_category(), "unable to write "+packPath(moved._pack).string());
+                }
+
+                PackStat& movedStat = _packStats[moved._pack];
+                movedStat._total += moved._size;
+                movedStat._live += moved._size;
+
+                location = moved;
+            }
+        }
+
+        //до этой точки старый индекс ссылается на старые, нетронутые pack-файлы
+        sync();
+        rewriteIndex();
+
+        uint64 res{};
+        for(uint32 pack : victims)
+        {
+            res += _packStats[pack]._total;
+            fs::remove(packPath(pack));
+            _packStats.erase(pack);
+        }
+
+        return res;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Pack::sync()
+    {
+        //сначала данные, потом ссылающийся на них индекс
+        if(_currentOut)
+        {
+            syncFile(_currentOut, packPath(_current));
+        }
+
+        if(_indexOut)
+        {
+            syncFile(_indexOut, indexPath());
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Pack::loadIndex()
+    {
+        if(!fs::is_directory(_dir))
+        {
+            return;
+        }
+
+        for(const fs::directory_entry& de : fs::directory_iterator{_dir})
+        {
+            if(!de.is_regular_file() || ".pack" != de.path().extension())
+            {
+                continue;
+            }
+
+            std::string stem = de.path().stem().string();
+            uint32 pack{};
+            auto [end, ec] = std::from_chars(stem.data(), stem.data()+stem.size(), pack, 16);
+            if(ec != std::errc{} || end != stem.data()+stem.size() || !pack)
+            {
+                if(_autoFixIfCan)
+                {
+                    fs::remove(de.path());
+                }
+                continue;
+            }
+
+            _packStats[pack]._total = de.file_size();
+            _current = std::max(_current, pack);
+        }
+
+        std::FILE* in = fopen(indexPath().string().c_str(), "rb");
+        if(!in)
+        {
+            return;
+        }
+
+        uint64 validSize{};
+        {
+            utils::AtScopeExit se = {[&]{fclose(in);}};
+
+            uint8 rec[g_recordSize];
+            while(g_recordSize == fread(rec, 1, g_recordSize, in))
+            {
+                validSize += g_recordSize;
+                _indexRecords++;
+
+                Oid oid;
+                Location location;
+                decode(rec, oid, location);
+
+                auto iter = _locations.find(oid);
+                if(_locations.end() != iter)
+                {
+                    _packStats[iter->second._pack]._live -= iter->second._size;
+                    _locations.erase(iter);
+                }
+
+                if(g_tombstone == location._size)
+                {
+                    continue;
+                }
+
+                auto statIter = _packStats.find(location._pack);
+                if(_packStats.end() == statIter || location._offset + location._size > statIter->second._total)
+                {
+                    LOGW("storage pack: dangling index record skipped");
+                    continue;
+                }
+
+                statIter->second._live += location._size;
+                _locations.emplace(oid, location);
+            }
+        }
+
+        if(_autoFixIfCan)
+        {
+            //оборванная последняя запись
+            if(fs::file_size(indexPath()) != validSize)
+            {
+                fs::resize_file(indexPath(), validSize);
+            }
+
+            //pack-файлы без живых объектов, например, после прерванной компактификации
+            for(auto iter = _packStats.begin(); iter != _packStats.end(); )
+            {
+                if(!iter->second._live)
+                {
+                    fs::remove(packPath(iter->first));
+                    iter = _packStats.erase(iter);
+                }
+                else
+                {
+                    ++iter;
+                }
+            }
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Pack::appendIndex(const Oid& oid, const Location& location)
+    {
+        if(!_indexOut)
+        {
+            fs::create_directories(_dir);
+            _indexOut = fopen(indexPath().string().c_str(), "ab");
+            if(!_indexOut)
+            {
+                throw std::system_error(errno, std::generic_category(), "unable to open "+indexPath().string());
+            }
+        }
+
+        uint8 rec[g_recordSize];
+        encode(rec, oid, location);
+
+        if(g_recordSize != fwrite(rec, 1, g_recordSize, _indexOut) || fflush(_indexOut))
+        {
+            throw std::system_error(errno, std::generic_category(), "unable to write "+indexPath().string());
+        }
+
+        _indexRecords++;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Pack::rewriteIndex()
+    {
+        if(_indexOut)
+        {
+            fclose(_indexOut);
+            _indexOut = nullptr;
+        }
+
+        fs::create_directories(_dir);
+
+        fs::path tmp = indexPath();
+        tmp += ".tmp";
+
+        {
+            std::FILE* out = fopen(tmp.string().c_str(), "wb");
+            if(!out)
+            {
+                throw std::system_error(errno, std::generic_category(), "unable to open "+tmp.string());
+            }
+            utils::AtScopeExit se = {[&]{fclose(out);}};
+
+            uint8 rec[g_recordSize];
+            for(const auto&[oid, location] : _locations)
+            {
+                encode(rec, oid, location);
+                if(g_recordSize != fwrite(rec, 1, g_recordSize, out))
+                {
+                    throw std::system_error(errno, std::generic_category(), "unable to write "+tmp.string());
+                }
+            }
+
+            syncFile(out, tmp);
+        }
+
+        fs::rename(tmp, indexPath());
+        syncDir(_dir);
+        _indexRecords = _locations.size();
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    std::FILE* Pack::packForAppend(Location& location)
+    {
+        if(_current && _packStats[_current]._total >= g_maxPackSize)
+        {
+            sync();
+            closeFiles();
+            _current++;
+        }
+
+        if(!_current)
+        {
+            _current = 1;
+        }
+
+        if(!_currentOut)
+        {
+            fs::create_directories(_dir);
+
+            fs::path path = packPath(_current);
+            _currentOut = fopen(path.string().c_str(), "ab");
+            if(!_currentOut)
+            {
+                throw std::system_error(errno, std::generic_category(), "unable to open "+path.string());
+            }
+
+            if(fseek(_currentOut, 0, SEEK_END))
+            {
+                throw std::system_error(errno, std::generic_category(), "unable to seek "+path.string());
+            }
+            _packStats[_current]._total = tell(_currentOut);
+        }
+
+        location._pack = _current;
+        location._offset = _packStats[_current]._total;
+        location._size = 0;
+
+        return _currentOut;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Pack::commitAppended(const Oid& oid, const Location& location)
+    {
+        if(fflush(_currentOut))
+        {
+            abandonCurrent();
+            throw std::system_error(errno, std::generic_category(), "unable to write "+packPath(location._pack).string());
+        }
+
+        PackStat& stat = _packStats[location._pack];
+        stat._total += location._size;
+
+        appendIndex(oid, location);
+
+        stat._live += location._size;
+        _locations.emplace(oid, location);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Pack::abandonCurrent()
+    {
+        //хвост текущего pack-файла в неизвестном состоянии, далее пишем в следующий
+        closeFiles();
+
+        //дописанное сверх учтенного - мусор, иначе compact этот pack-файл не выберет
+        std::error_code ec;
+        uint64 size = fs::file_size(packPath(_current), ec);
+        if(!ec)
+        {
+            PackStat& stat = _packStats[_current];
+            stat._total = std::max(stat._total, size);
+        }
+
+        _current++;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    fs::path Pack::packPath(uint32 pack) const
+    {
+        char name[32];
+        std::snprintf(name, sizeof(name), "%08x.pack", pack);
+        return _dir / name;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    fs::path Pack::indexPath() const
+    {
+        return _dir / "index";
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Pack::closeFiles()
+    {
+        if(_currentOut)
+        {
+            fclose(_currentOut);
+            _currentOut = nullptr;
+        }
+
+        if(_indexOut)
+        {
+            fclose(_indexOut);
+            _indexOut = nullptr;
+        }
+    }
+}
@@ -0,0 +1,94 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+#pragma once
+
+#include <dci/bytes.hpp>
+#include <dci/aup/oid.hpp>
+#include <dci/aup/storage/mapping.hpp>
+#include <optional>
+#include <filesystem>
+
+namespace dci::aup::impl::storage
+{
+    /* упакованное хранилище
+     *
+     * объекты дописываются в конец pack-файлов <dir>/xxxxxxxx.pack,
+     * их расположение фиксируется в журнале-индексе <dir>/index записями фиксированного размера (oid, pack, offset, size),
+     * удаление - запись-надгробие в индексе, место в pack-файле освобождается только компактификацией
+     */
+    class Pack final
+    {
+        Pack(const Pack&) = delete;
+        Pack(Pack&&) = delete;
+
+        void operator=(const Pack&) = delete;
+        void operator=(Pack&&) = delete;
+
+    public:
+        struct Location
+        {
+            uint32 _pack {};
+            uint64 _offset {};
+            uint64 _size {};
+        };
+
+        using Locations = std::map<Oid, Location>;
+
+    public:
+        Pack();
+        ~Pack();
+
+        void open(const std::filesystem::path& dir, bool autoFixIfCan);
+        void close();
+
+    public:
+        const Locations& locations() const;
+        const Location* locate(const Oid& oid) const;
+        std::filesystem::path packPath(uint32 pack) const;
+
+        void put(const Oid& oid, Bytes&& blob);
+        void put(const Oid& oid, std::FILE* f);
+        std::optional<Bytes> get(const Oid& oid, uint64 offset=0, uint64 size=~uint64{0});
+        std::optional<aup::storage::Mapping> map(const Oid& oid);
+        bool del(const Oid& oid);
+
+        uint64 compact();
+        void sync();
+
+    private:
+        void loadIndex();
+        void appendIndex(const Oid& oid, const Location& location);
+        void rewriteIndex();
+
+        std::FILE* packForAppend(Location& location);
+        void commitAppended(const Oid& oid, const Location& location);
+        void abandonCurrent();
+
+        std::filesystem::path indexPath() const;
+
+        void closeFiles();
+
+    private:
+        std::filesystem::path   _dir;
+        bool                    _autoFixIfCan {true};
+
+        Locations               _locations;
+
+        struct PackStat
+        {
+            uint64 _total {};
+            uint64 _live {};
+        };
+        std::map<uint32, PackStat> _packStats;
+        uint64                  _indexRecords {};
+
+        uint32                  _current {};
+        std::FILE*              _currentOut {};
+        std::FILE*              _indexOut {};
+    };
+}
@@ -0,0 +1,33 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+#pragma once
+
+#include <dci/primitives.hpp>
+#include <cstdio>
+
+namespace dci::aup::impl::storage
+{
+    //позиционирование за пределами 2/4 GiB
+    inline int seek(std::FILE* f, uint64 pos)
+    {
+#ifdef _WIN32
+        return _fseeki64(f, static_cast<int64>(pos), SEEK_SET);
+#else
+        return fseeko(f, static_cast<off_t>(pos), SEEK_SET);
+#endif
+    }
+
+    inline uint64 tell(std::FILE* f)
+    {
+#ifdef _WIN32
+        return static_cast<uint64>(_ftelli64(f));
+#else
+        return static_cast<uint64>(ftello(f));
+#endif
+    }
+}
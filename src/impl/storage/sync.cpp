@@ -0,0 +1,88 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+#include "sync.hpp"
+#include <dci/utils/atScopeExit.hpp>
+#include <system_error>
+
+#ifdef _WIN32
+#   include <io.h>
+#else
+#   include <fcntl.h>
+#   include <unistd.h>
+#endif
+
+namespace dci::aup::impl::storage
+{
+    namespace fs = std::filesystem;
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void syncFile(std::FILE* f, const fs::path& path)
+    {
+        if(fflush(f))
+        {
+            throw std::system_error(errno, std::generic_category(), "unable to write "+path.string());
+        }
+
+#ifdef _WIN32
+        if(_commit(_fileno(f)))
+#else
+        if(fsync(fileno(f)))
+#endif
+        {
+            throw std::system_error(errno, std::generic_category(), "unable to sync "+path.string());
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void syncFile(const fs::path& path)
+    {
+#ifdef _WIN32
+        std::FILE* f = _wfopen(path.c_str(), L"r+b");
+        if(!f)
+        {
+            throw std::system_error(errno, std::generic_category(), "unable to open "+path.string());
+        }
+        utils::AtScopeExit se = {[&]{fclose(f);}};
+
+        syncFile(f, path);
+#else
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if(0 > fd)
+        {
+            throw std::system_error(errno, std::generic_category(), "unable to open "+path.string());
+        }
+        utils::AtScopeExit se = {[&]{::close(fd);}};
+
+        if(fsync(fd))
+        {
+            throw std::system_error(errno, std::generic_category(), "unable to sync "+path.string());
+        }
+#endif
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void syncDir(const fs::path& path)
+    {
+#ifdef _WIN32
+        //каталоги не синхронизируются, NTFS журналирует метаданные сама
+        (void)path;
+#else
+        int fd = ::open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if(0 > fd)
+        {
+            throw std::system_error(errno, std::generic_category(), "unable to open "+path.string());
+        }
+        utils::AtScopeExit se = {[&]{::close(fd);}};
+
+        if(fsync(fd) && EINVAL != errno)
+        {
+            throw std::system_error(errno, std::generic_category(), "unable to sync "+path.string());
+        }
+#endif
+    }
+}
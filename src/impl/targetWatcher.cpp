@@ -0,0 +1,262 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+
+#include "targetWatcher.hpp"
+#include <dci/logger.hpp>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+#ifdef __linux__
+#   include <sys/inotify.h>
+#   include <unistd.h>
+#   include <limits.h>
+#endif
+
+namespace dci::aup::impl
+{
+    namespace fs = std::filesystem;
+
+#ifdef __linux__
+    namespace
+    {
+        constexpr uint32 g_mask =
+                IN_CREATE | IN_DELETE | IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE |
+                IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF |
+                IN_ONLYDIR | IN_DONT_FOLLOW | IN_EXCL_UNLINK;
+    }
+#endif
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    TargetWatcher::TargetWatcher()
+    {
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    TargetWatcher::~TargetWatcher()
+    {
+        stop();
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void TargetWatcher::start(const fs::path& root)
+    {
+        stop();
+        _root = fs::weakly_canonical(root);
+        open();
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void TargetWatcher::stop()
+    {
+        close();
+        _root.clear();
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void TargetWatcher::drain()
+    {
+#ifdef __linux__
+        if(0 > _fd)
+        {
+            return;
+        }
+
+        alignas(struct inotify_event) char buf[64 * 1024];
+
+        for(;;)
+        {
+            ssize_t amount = ::read(_fd, buf, sizeof(buf));
+            if(0 > amount)
+            {
+                if(EINTR == errno)
+                {
+                    continue;
+                }
+
+                if(EAGAIN != errno)
+                {
+                    LOGW("target watcher: unable to read events: "<<std::strerror(errno));
+                    _valid = false;
+                }
+                break;
+            }
+
+            if(!amount)
+            {
+                break;
+            }
+
+            for(ssize_t pos{}; pos < amount;)
+            {
+                const struct inotify_event* e = reinterpret_cast<const struct inotify_event*>(buf + pos);
+                pos += static_cast<ssize_t>(sizeof(struct inotify_event) + e->len);
+
+                if(e->mask & IN_Q_OVERFLOW)
+                {
+                    _valid = false;
+                    continue;
+                }
+
+                auto iter = _dirs.find(e->wd);
+                if(_dirs.end() == iter)
+                {
+                    continue;
+                }
+
+                if(e->mask & IN_IGNORED)
+                {
+                    _dirs.erase(iter);
+                    continue;
+                }
+
+                const std::string& dirRel = iter->second;
+
+                if((e->mask & (IN_DELETE_SELF | IN_MOVE_SELF)) && dirRel.empty())
+                {
+                    //корень исчез или подменен
+                    _valid = false;
+                    continue;
+                }
+
+                if(!e->len)
+                {
+                    //о самом каталоге, по имени его сообщит родитель
+                    continue;
+                }
+
+                std::string rel = dirRel.empty() ? std::string{e->name} : dirRel + "/" + e->name;
+                _dirty.insert(rel);
+
+                if((e->mask & IN_ISDIR) && (e->mask & (IN_CREATE | IN_MOVED_TO)))
+                {
+                    //содержимое, появившееся до установки наблюдения, уже покрыто грязным каталогом
+                    watch(_root / rel, rel);
+                }
+            }
+        }
+#endif
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    std::optional<std::set<std::string>> TargetWatcher::take()
+    {
+        if(_root.empty())
+        {
+            return {};
+        }
+
+        drain();
+
+        if(!_valid || !_baseline)
+        {
+            //начать заново, предстоящая полная проверка покрывает все, что было до этого момента
+            if(!_valid)
+            {
+                close();
+                open();
+            }
+
+            _dirty.clear();
+            _baseline = _valid;
+            return {};
+        }
+
+        std::set<std::string> res;
+        res.swap(_dirty);
+        return res;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void TargetWatcher::invalidate()
+    {
+        _valid = false;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void TargetWatcher::open()
+    {
+#ifdef __linux__
+        _fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if(0 > _fd)
+        {
+            LOGW("target watcher: unable to init inotify: "<<std::strerror(errno));
+            return;
+        }
+
+        _valid = true;
+        watch(_root, std::string{});
+
+        if(_dirs.empty())
+        {
+            //корня нет - следить не за чем, до его появления проверки полные
+            _valid = false;
+        }
+#endif
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void TargetWatcher::close()
+    {
+#ifdef __linux__
+        if(0 <= _fd)
+        {
+            ::close(_fd);
+        }
+#endif
+        _fd = -1;
+        _valid = false;
+        _baseline = false;
+        _dirs.clear();
+        _dirty.clear();
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void TargetWatcher::watch(const fs::path& dir, const std::string& rel)
+    {
+#ifdef __linux__
+        std::vector<std::pair<fs::path, std::string>> stack{{dir, rel}};
+
+        while(!stack.empty() && _valid)
+        {
+            auto [path, prefix] = std::move(stack.back());
+            stack.pop_back();
+
+            int wd = ::inotify_add_watch(_fd, path.c_str(), g_mask);
+            if(0 > wd)
+            {
+                if(ENOENT == errno || ENOTDIR == errno)
+                {
+                    //исчез, событие о нем придет родителю
+                    continue;
+                }
+
+                //например, ENOSPC - исчерпан max_user_watches
+                LOGW("target watcher: unable to watch "<<path.string()<<": "<<std::strerror(errno));
+                _valid = false;
+                break;
+            }
+
+            _dirs[wd] = prefix;
+
+            std::error_code ec;
+            for(const fs::directory_entry& entry : fs::directory_iterator(path, ec))
+            {
+                if(entry.is_directory(ec) && !entry.is_symlink(ec))
+                {
+                    std::string name = entry.path().filename().string();
+                    stack.emplace_back(entry.path(), prefix.empty() ? name : prefix + "/" + name);
+                }
+            }
+        }
+#else
+        (void)dir;
+        (void)rel;
+#endif
+    }
+}
@@ -0,0 +1,63 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+
+#pragma once
+
+#include <dci/primitives.hpp>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <map>
+#include <set>
+
+namespace dci::aup::impl
+{
+    /* слежение за целевым каталогом, накапливает пути (относительно корня), измененные с прошлого take
+     *
+     * на linux - inotify на каждый каталог дерева, иначе слежения нет и take всегда требует полной проверки;
+     * переполнение очереди событий, перемещение/удаление корня или нехватка наблюдений делают накопленное
+     * недостоверным - следующий take сообщит nullopt и начнет слежение заново
+     */
+    class TargetWatcher final
+    {
+        TargetWatcher(const TargetWatcher&) = delete;
+        TargetWatcher(TargetWatcher&&) = delete;
+
+        void operator=(const TargetWatcher&) = delete;
+        void operator=(TargetWatcher&&) = delete;
+
+    public:
+        TargetWatcher();
+        ~TargetWatcher();
+
+        void start(const std::filesystem::path& root);
+        void stop();
+
+        //вычитать накопившиеся события, не блокирует
+        void drain();
+
+        //измененное с прошлого take, nullopt - нужна полная проверка
+        std::optional<std::set<std::string>> take();
+
+        //накопленному нельзя доверять (например, применение не удалось)
+        void invalidate();
+
+    private:
+        void open();
+        void close();
+        void watch(const std::filesystem::path& dir, const std::string& rel);
+
+    private:
+        std::filesystem::path       _root;
+        int                         _fd {-1};
+        bool                        _valid {};
+        bool                        _baseline {};//полная проверка с начала слежения уже была
+        std::map<int, std::string>  _dirs;//наблюдение -> каталог относительно корня
+        std::set<std::string>       _dirty;
+    };
+}
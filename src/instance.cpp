@@ -12,15 +12,20 @@
 #include <dci/aup/catalog/identify.hpp>
 #include <dci/logger.hpp>
 #include <dci/crypto/ed25519.hpp>
+#include <dci/crypto/blake3.hpp>
 #include <dci/utils/b2h.hpp>
 #include <dci/utils/h2b.hpp>
 
 #include "dci/integration/info.hpp"
 #include "impl/applier.hpp"
+#include "impl/metaPaths.hpp"
 #include "impl/catalog/serializeObject.hpp"
 #include "impl/catalog/deserializeObject.hpp"
+#include <dci/stiac/serialization.hpp>
 
 #include <filesystem>
+#include <algorithm>
+#include <cstring>
 
 namespace std
 {
@@ -54,6 +59,54 @@ namespace dci::aup
                                            r->_signature.data());
         }
 
+        //восстанавливаемое содержимое - во временный файл, хэш считается по ходу записи
+        class Reconstruction
+        {
+        public:
+            explicit Reconstruction(std::FILE* file)
+                : _file{file}
+            {
+            }
+
+            ~Reconstruction()
+            {
+                fclose(_file);
+            }
+
+            void write(const void* data, uint64 size)
+            {
+                if(size != fwrite(data, 1, size, _file))
+                {
+                    throw std::system_error(errno, std::generic_category(), "unable to write reconstructed content");
+                }
+
+                _hashier.add(data, size);
+                _size += size;
+            }
+
+            uint64 size() const
+            {
+                return _size;
+            }
+
+            Oid finish()
+            {
+                Oid res;
+                _hashier.finish(res.data());
+                return res;
+            }
+
+            std::FILE* file()
+            {
+                return _file;
+            }
+
+        private:
+            std::FILE*      _file;
+            crypto::Blake3  _hashier{32};
+            uint64          _size {};
+        };
+
         void dump(const Oid& oid, const catalog::Release* r)
         {
             LOGI("release                : "<<utils::b2h(oid));
@@ -99,11 +152,11 @@ namespace dci::aup
 
         _importer.emitData() += [this](impl::Catalog* c, impl::Storage* s)
         {
-            _catalog.import(c, [](const Oid&/*oid*/, const catalog::ObjectPtr& object)
+            _catalog.import(c, [](const Oid&/*oid*/, const catalog::Object* object)
             {
                 if(catalog::Object::Type::release == object->type())
                 {
-                    return checkSignature(catalog::objectPtrCast<catalog::Release>(object.get()));
+                    return checkSignature(catalog::objectPtrCast<catalog::Release>(object));
                 }
 
                 return true;
@@ -132,14 +185,33 @@ namespace dci::aup
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     void Instance::start(const std::vector<std::string>& args)
     {
-        using namespace boost::property_tree;
+        boost::property_tree::ptree c;
 
         try
         {
-            ptree c = config::parse(args);
+            c = config::parse(args);
+        }
+        catch(...)
+        {
+            std::throw_with_nested(Exception{"unable to start instance"});
+        }
 
+        start(c);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Instance::start(const boost::property_tree::ptree& c)
+    {
+        try
+        {
             _targetDir = c.get("targetDir", "..");
-            _storage.reset(c.get("stateDir", "../var/aup"), true);
+            _targetParanoid = c.get("targetParanoid", false);
+            if(c.get("targetWatch", false))
+            {
+                _targetWatcher.start(_targetDir);
+                _targetWatchTicker.start();
+            }
+            _storage.reset(c.get("stateDir", "../var/aup"), true, "pack" == c.get("stateLayout", std::string{"loose"}), c.get("stateCompress", false));
 
             for(const auto& kv : c.equal_range("target"))
             {
@@ -171,16 +243,23 @@ namespace dci::aup
     void Instance::stop()
     {
         saveCatalog(false);
+        flushStorage(false);
 
         _importer.stop();
 
         _targetDir.clear();
+        _targetParanoid = false;
+        _targetWatchTicker.stop();
+        _targetWatcher.stop();
         _targetCriterias.clear();
         _bufferCriterias.clear();
 
         _catalog.reset();
+        _catalogCheckpointSize = 0;
+        _catalogJournalSize = 0;
         _catalogSaveTicker.stop();
 
+        _storageFlushTicker.stop();
         _storage.reset();
 
         _index.reset();
@@ -198,10 +277,13 @@ namespace dci::aup
     {
         applier::Result res{};
 
+        try
         {
             impl::Applier a;
             a.addCatalog(&_catalog);
             a.addStorage(&_storage);
+            a.setStatCache(&_storage, impl::g_targetStatPath);
+            a.setDirty(_targetWatcher.take());
 
             for(const auto&[k, v] : collectRoots4UpdateTarget())
             {
@@ -213,7 +295,21 @@ namespace dci::aup
                                 applier::tRemoveWrongs |
                                 applier::tEmplaceMissings |
                                 applier::tEmplaceChanges |
-                                applier::tRemoveExtra));
+                                applier::tRemoveExtra |
+                                applier::tParallel |
+                                (_targetParanoid ? applier::tParanoid : applier::tNull)));
+        }
+        catch(...)
+        {
+            //взятое у наблюдателя измененное не применено и потеряно, следующее применение - с полной проверкой
+            _targetWatcher.invalidate();
+            throw;
+        }
+
+        if(res & applier::rSomeFailed)
+        {
+            //место в неизвестном состоянии, следующее применение - с полной проверкой
+            _targetWatcher.invalidate();
         }
 
         _onTargetUpdated.in(res);
@@ -222,20 +318,28 @@ namespace dci::aup
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     void Instance::collectGarbage()
     {
-        Set<Oid> requiredsCatalog, requiredsStorage;
+        //весь граф обходится разом, номера вместо oid держат множества компактными
+        impl::OidInterner oids;
+        impl::HandleSet requiredsCatalog, requiredsStorage;
 
         for(const Oid& oid : _index._allReleases)
         {
-            collectRequireds(oid, requiredsCatalog, requiredsStorage);
+            collectRequireds(oid, oids, requiredsCatalog, requiredsStorage);
         }
 
-        uint32 dropped = _storage.dropOthersThan(requiredsStorage);
+        uint32 dropped = _storage.dropOthersThan(oids, requiredsStorage);
         if(dropped)
         {
             LOGI("drop "<<dropped<<" garbage object(s) from storage");
         }
 
-        dropped = _catalog.dropOthersThan(requiredsCatalog);
+        uint64 reclaimed = _storage.compact();
+        if(reclaimed)
+        {
+            LOGI("compact storage, "<<reclaimed<<" byte(s) reclaimed");
+        }
+
+        dropped = _catalog.dropOthersThan(oids, requiredsCatalog);
         if(dropped)
         {
             LOGI("drop "<<dropped<<" garbage object(s) from catalog");
@@ -404,7 +508,7 @@ namespace dci::aup
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     bool Instance::hasStorageObject(const Oid& oid)
     {
-        return _storage.has(oid);
+        return hasChunk(oid);
     }
 
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
@@ -421,9 +525,39 @@ namespace dci::aup
     }
 
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
-    std::optional<Bytes> Instance::getStorageObject(const Oid& oid, uint32 offset, uint32 size)
+    std::optional<Bytes> Instance::getStorageObject(const Oid& oid, uint64 offset, uint64 size)
     {
-        return _storage.get(oid, offset, size);
+        //кусок отдается и из содержимого, в которое он входит
+        return getChunk(oid, offset, size);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    std::optional<storage::Mapping> Instance::mapStorageObject(const Oid& oid)
+    {
+        std::optional<storage::Mapping> res = _storage.map(oid);
+        if(res || !_chunkSources.count(oid))
+        {
+            return res;
+        }
+
+        std::optional<Bytes> chunk = getChunk(oid);
+        if(!chunk)
+        {
+            return res;
+        }
+
+        res.emplace();
+        uint8* dst = res->allocate(chunk->size());
+
+        bytes::Cursor c{chunk->begin()};
+        while(!c.atEnd())
+        {
+            std::memcpy(dst, c.continuousData(), c.continuousDataSize());
+            dst += c.continuousDataSize();
+            c.advanceChunks(1);
+        }
+
+        return res;
     }
 
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
@@ -497,7 +631,15 @@ namespace dci::aup
             return instance::io::PutObjectResult::corrupted;
         }
 
+        _storage.batchBegin();
         _storage.put(oid, std::move(blob));
+        if(!_storageFlushTicker.started())
+        {
+            _storageFlushTicker.start();
+        }
+        completeByDelta(oid);
+        completeByChunk(oid);
+        addChunkSources(oid);
         updateIndexAfterStorageObjectComplete(true, oid);
 
         return instance::io::PutObjectResult::ok;
@@ -516,28 +658,158 @@ namespace dci::aup
             return instance::io::PutObjectResult::corrupted;
         }
 
+        _storage.batchBegin();
         _storage.put(oid, f.get());
+        if(!_storageFlushTicker.started())
+        {
+            _storageFlushTicker.start();
+        }
+        completeByDelta(oid);
+        completeByChunk(oid);
+        addChunkSources(oid);
         updateIndexAfterStorageObjectComplete(true, oid);
 
         return instance::io::PutObjectResult::ok;
     }
 
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    std::vector<uint64> Instance::storageObjectChunks(const Oid& oid)
+    {
+        std::vector<const catalog::Chunked*> cs = chunkedFor(oid);
+        if(cs.empty())
+        {
+            return {};
+        }
+
+        return cs.front()->_chunkSizes;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    bool Instance::verifyStorageObjectRange(const Oid& oid, uint64 offset, const Bytes& blob)
+    {
+        std::vector<const catalog::Chunked*> cs = chunkedFor(oid);
+        std::size_t first;
+        return std::any_of(cs.begin(), cs.end(), [&](const catalog::Chunked* c){return verifyRange(c, offset, blob, first);});
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    instance::io::PutObjectResult Instance::putStorageObjectRange(const Oid& oid, uint64 offset, Bytes&& blob)
+    {
+        auto wanted = [&](const Oid& o)
+        {
+            return _index._targetStorageIncomplete.count(o) || _index._bufferStorageIncomplete.count(o);
+        };
+
+        //без нарезки проверяется только объект целиком
+        std::vector<const catalog::Chunked*> cs = chunkedFor(oid);
+        std::erase_if(cs, [&](const catalog::Chunked* c){return !(wanted(oid) || std::any_of(c->_chunks.begin(), c->_chunks.end(), wanted));});
+        if(cs.empty())
+        {
+            return instance::io::PutObjectResult::unwanted;
+        }
+
+        //у содержимого может быть несколько нарезок, диапазон принимается по любой сошедшейся
+        const catalog::Chunked* c{};
+        std::size_t first{};
+        for(const catalog::Chunked* candidate : cs)
+        {
+            if(verifyRange(candidate, offset, blob, first))
+            {
+                c = candidate;
+                break;
+            }
+        }
+
+        if(!c)
+        {
+            return instance::io::PutObjectResult::corrupted;
+        }
+
+        //куски лежат отдельно до сборки, collectRequireds держит их пока содержимого нет
+        _storage.batchBegin();
+        bytes::Alter a{blob.begin()};
+        for(std::size_t index{first}; !blob.empty(); ++index)
+        {
+            //кусок отделяется от диапазона без копирования
+            Bytes part;
+            a.removeTo(part, static_cast<uint32>(c->_chunkSizes[index]));
+
+            const Oid& chunk = c->_chunks[index];
+            if(hasChunk(chunk))
+            {
+                continue;
+            }
+
+            _storage.put(chunk, std::move(part));
+            if(!_storageFlushTicker.started())
+            {
+                _storageFlushTicker.start();
+            }
+
+            //запрошенный вместо содержимого
+            if(wanted(chunk))
+            {
+                completeByChunk(chunk);
+                updateIndexAfterStorageObjectComplete(true, chunk);
+            }
+        }
+
+        if(wanted(oid) && !_storage.has(oid) &&
+           std::all_of(c->_chunks.begin(), c->_chunks.end(), [&](const Oid& chunk){return hasChunk(chunk);}) &&
+           reconstructByChunks(c))
+        {
+            updateIndexAfterStorageObjectComplete(true, oid);
+        }
+
+        return instance::io::PutObjectResult::ok;
+    }
+
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     void Instance::loadCatalog()
     {
         try
         {
-            std::optional<Bytes> blob = _storage.get("catalog");
-            if(blob)
+            //снимок отображается в память, объекты разбираются по мере обращения
+            std::optional<storage::Mapping> mapping = _storage.map(impl::g_catalogPath);
+            if(!mapping)
             {
-                _catalog.deserialize(std::move(*blob));
+                _storage.del(impl::g_catalogJournalPath);
+            }
+            else
+            {
+                _catalogCheckpointSize = mapping->size();
+                _catalog.attach(std::move(*mapping));
+
+                std::optional<Bytes> journal = _storage.get(impl::g_catalogJournalPath);
+                if(journal)
+                {
+                    _catalogJournalSize = journal->size();
+
+                    try
+                    {
+                        stiac::serialization::Arch arch{journal->begin()};
+                        while(!arch.atEnd())
+                        {
+                            Bytes changes;
+                            arch >> changes;
+                            _catalog.deserializeChanges(std::move(changes));
+                        }
+                    }
+                    catch(...)
+                    {
+                        //хвост журнала оборван или не относится к снимку, дописывать после него нельзя
+                        LOGW("catalog journal tail dropped: "<<dci::exception::toString(std::current_exception()));
+                        _catalogCheckpointSize = 0;
+                        _catalogSaveTicker.start();
+                    }
+                }
 
                 Set<Oid> badReleases;
                 for(const Oid& oid: _catalog.enumerate(catalog::Object::Type::release))
                 {
-                    catalog::ReleasePtr r = catalog::objectPtrCast<catalog::Release>(_catalog.get(oid));
+                    const catalog::Release* r = catalog::objectPtrCast<catalog::Release>(_catalog.find(oid));
 
-                    if(!checkSignature(r.get()))
+                    if(!checkSignature(r))
                     {
                         LOGW("bad release found, signature mismatch: "<<utils::b2h(r->_signer)<<", "<<utils::b2h(r->_signature));
                         badReleases.insert(oid);
@@ -573,7 +845,30 @@ namespace dci::aup
         try
         {
             _catalogSaveTicker.stop();
-            _storage.put("catalog", _catalog.serialize());
+
+            //полный снимок, когда журнал перерос его половину, иначе только изменения
+            if(!_catalogCheckpointSize || _catalogJournalSize > std::max(_catalogCheckpointSize/2, uint64{1024*1024}))
+            {
+                //снимок не должен зависнуть в отложенной фиксации хранилища, журнал удаляется сразу
+                flushStorage(false);
+
+                Bytes blob = _catalog.serialize();
+                _catalogCheckpointSize = blob.size();
+                _storage.put(impl::g_catalogPath, std::move(blob));
+                _storage.del(impl::g_catalogJournalPath);
+                _catalogJournalSize = 0;
+            }
+            else if(_catalog.changed())
+            {
+                Bytes record;
+                {
+                    stiac::serialization::Arch arch{record.begin()};
+                    arch << _catalog.serializeChanges();
+                }
+
+                _catalogJournalSize += record.size();
+                _storage.append(impl::g_catalogJournalPath, std::move(record));
+            }
         }
         catch(...)
         {
@@ -581,6 +876,25 @@ namespace dci::aup
         }
     }
 
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Instance::flushStorage(bool force)
+    {
+        if(!force && !_storageFlushTicker.started())
+        {
+            return;
+        }
+
+        try
+        {
+            _storageFlushTicker.stop();
+            _storage.batchCommit();
+        }
+        catch(...)
+        {
+            LOGW("unable to flush storage: "<<dci::exception::toString(std::current_exception()));
+        }
+    }
+
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     Instance::Roots Instance::collectRoots4UpdateTarget()
     {
@@ -588,14 +902,14 @@ namespace dci::aup
 
         for(const Oid& releaseOid : _index._targetMostReleases)
         {
-            catalog::ReleasePtr r = catalog::objectPtrCast<catalog::Release>(_catalog.get(releaseOid));
+            const catalog::Release* r = catalog::objectPtrCast<catalog::Release>(_catalog.find(releaseOid));
 
             LOGI("releases for update target:");
-            dump(releaseOid, r.get());
+            dump(releaseOid, r);
 
             for(const Oid& unitOid : r->_dependencies)
             {
-                catalog::UnitPtr u = catalog::objectPtrCast<catalog::Unit>(_catalog.get(unitOid));
+                const catalog::Unit* u = catalog::objectPtrCast<catalog::Unit>(_catalog.find(unitOid));
                 if(!u)
                 {
                     continue;
@@ -603,7 +917,7 @@ namespace dci::aup
 
                 for(const instance::Criteria& c : _targetCriterias)
                 {
-                    if(c.match(u.get()))
+                    if(c.match(u))
                     {
                         auto& rootValue = res[unitOid];
 
@@ -637,13 +951,13 @@ namespace dci::aup
     }
 
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
-    void Instance::collectRequireds(const Oid& oid, Set<Oid>& requiredsCatalog, Set<Oid>& requiredsStorage)
+    void Instance::collectRequireds(const Oid& oid, impl::OidInterner& oids, impl::HandleSet& requiredsCatalog, impl::HandleSet& requiredsStorage)
     {
-        catalog::ObjectPtr o = _catalog.get(oid);
+        const catalog::Object* o = _catalog.find(oid);
 
         if(!o)
         {
-            requiredsCatalog.insert(oid);
+            requiredsCatalog.insert(oids.intern(oid));
             return;
         }
 
@@ -651,33 +965,57 @@ namespace dci::aup
         {
         case catalog::Object::Type::release:
             {
-                catalog::Release* r = catalog::objectPtrCast<catalog::Release>(o.get());
+                const catalog::Release* r = catalog::objectPtrCast<catalog::Release>(o);
                 if(!match(r, false))
                 {
-                    requiredsCatalog.insert(oid);
+                    requiredsCatalog.insert(oids.intern(oid));
                     return;
                 }
             }
             break;
         case catalog::Object::Type::unit:
             {
-                catalog::Unit* u = catalog::objectPtrCast<catalog::Unit>(o.get());
+                const catalog::Unit* u = catalog::objectPtrCast<catalog::Unit>(o);
                 if(!match(u, false))
                 {
-                    requiredsCatalog.insert(oid);
+                    requiredsCatalog.insert(oids.intern(oid));
                     return;
                 }
             }
             break;
         case catalog::Object::Type::file:
             {
-                catalog::File* f = catalog::objectPtrCast<catalog::File>(o.get());
+                const catalog::File* f = catalog::objectPtrCast<catalog::File>(o);
                 if(!match(f, false))
                 {
-                    requiredsCatalog.insert(oid);
+                    requiredsCatalog.insert(oids.intern(oid));
                     return;
                 }
-                requiredsStorage.insert(f->_content);
+                requiredsStorage.insert(oids.intern(f->_content));
+            }
+            break;
+        case catalog::Object::Type::delta:
+            {
+                //база и тело нужны пока содержимое не восстановлено
+                const catalog::Delta* d = catalog::objectPtrCast<catalog::Delta>(o);
+                if(!_storage.has(d->_target))
+                {
+                    requiredsStorage.insert(oids.intern(d->_base));
+                    requiredsStorage.insert(oids.intern(d->_content));
+                }
+            }
+            break;
+        case catalog::Object::Type::chunked:
+            {
+                //куски нужны пока содержимое не собрано, после - они есть в нем самом
+                const catalog::Chunked* c = catalog::objectPtrCast<catalog::Chunked>(o);
+                if(!_storage.has(c->_target))
+                {
+                    for(const Oid& chunk : c->_chunks)
+                    {
+                        requiredsStorage.insert(oids.intern(chunk));
+                    }
+                }
             }
             break;
         default:
@@ -685,11 +1023,11 @@ namespace dci::aup
             break;
         }
 
-        if(requiredsCatalog.insert(oid).second)
+        if(requiredsCatalog.insert(oids.intern(oid)))
         {
             for(const Oid& dep : o->_dependencies)
             {
-                collectRequireds(dep, requiredsCatalog, requiredsStorage);
+                collectRequireds(dep, oids, requiredsCatalog, requiredsStorage);
             }
         }
     }
@@ -704,10 +1042,10 @@ namespace dci::aup
             {
                 if(verbose)
                 {
-                    catalog::ReleasePtr r = catalog::objectPtrCast<catalog::Release>(_catalog.get(oid));
+                    const catalog::Release* r = catalog::objectPtrCast<catalog::Release>(_catalog.find(oid));
 
                     LOGI("new release found:");
-                    dump(oid, r.get());
+                    dump(oid, r);
                 }
 
                 _onNewReleaseFound.in(oid);
@@ -847,12 +1185,14 @@ namespace dci::aup
         s2.swap(_index);
 
         emitIndexChanges(verbose, s2);
+        completeReadyDeltas(verbose);
+        completeReadyChunked(verbose);
     }
 
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     void Instance::updateIndexAfterCatalogObjectComplete(bool verbose, const Oid& oid)
     {
-        catalog::ObjectPtr o = _catalog.get(oid);
+        const catalog::Object* o = _catalog.find(oid);
         if(!o)
         {
             return;
@@ -869,12 +1209,12 @@ namespace dci::aup
         {
             _index._targetCatalogIncomplete.erase(iter);
 
-            if(match(o.get(), _targetCriterias))
+            if(match(o, _targetCriterias))
             {
                 collectObjectsIndex(
                             _targetCriterias,
                             oid,
-                            o.get(),
+                            o,
                             targetCatalogIncomplete,
                             targetCatalogComplete,
                             targetStorageIncomplete,
@@ -898,12 +1238,12 @@ namespace dci::aup
         {
             _index._bufferCatalogIncomplete.erase(iter);
 
-            if(match(o.get(), _bufferCriterias))
+            if(match(o, _bufferCriterias))
             {
                 collectObjectsIndex(
                             _bufferCriterias,
                             oid,
-                            o.get(),
+                            o,
                             bufferCatalogIncomplete,
                             bufferCatalogComplete,
                             bufferStorageIncomplete,
@@ -927,6 +1267,78 @@ namespace dci::aup
         _index._bufferStorageIncomplete .insert(bufferStorageIncomplete .begin(), bufferStorageIncomplete   .end());
         _index._bufferStorageComplete   .insert(bufferStorageComplete   .begin(), bufferStorageComplete     .end());
 
+        // дельта, пришедшая после своего файла, заменяет запрос содержимого целиком
+        if(const catalog::Delta* d = catalog::objectPtrCast<catalog::Delta>(o))
+        {
+            bool forTarget = _index._targetStorageIncomplete.count(d->_target);
+            bool forBuffer = _index._bufferStorageIncomplete.count(d->_target);
+
+            if((forTarget || forBuffer) && _storage.has(d->_base) && !_deltaByContent.count(d->_content))
+            {
+                _deltaByContent[d->_content] = oid;
+                if(_storage.has(d->_content))
+                {
+                    _readyDeltas.insert(d->_content);
+                }
+
+                if(forTarget)
+                {
+                    _index._targetStorageIncomplete.erase(d->_target);
+                    _index._targetStorageIncomplete.insert(d->_content);
+                    targetStorageIncomplete.insert(d->_content);
+                }
+
+                if(forBuffer)
+                {
+                    _index._bufferStorageIncomplete.erase(d->_target);
+                    _index._bufferStorageIncomplete.insert(d->_content);
+                    bufferStorageIncomplete.insert(d->_content);
+                }
+            }
+        }
+
+        // нарезка, пришедшая после своего файла, заменяет запрос содержимого недостающими кусками
+        if(const catalog::Chunked* c = catalog::objectPtrCast<catalog::Chunked>(o))
+        {
+            indexChunked(oid, c);
+
+            bool forTarget = _index._targetStorageIncomplete.count(c->_target);
+            bool forBuffer = _index._bufferStorageIncomplete.count(c->_target);
+
+            if((forTarget || forBuffer) && usableChunked(c))
+            {
+                if(std::all_of(c->_chunks.begin(), c->_chunks.end(), [&](const Oid& chunk){return hasChunk(chunk);}))
+                {
+                    _readyChunked.insert(oid);
+                }
+                else
+                {
+                    if(forTarget) _index._targetStorageIncomplete.erase(c->_target);
+                    if(forBuffer) _index._bufferStorageIncomplete.erase(c->_target);
+
+                    for(const Oid& chunk : c->_chunks)
+                    {
+                        if(hasChunk(chunk))
+                        {
+                            continue;
+                        }
+
+                        _chunkedByChunk[chunk].insert(oid);
+
+                        if(forTarget && _index._targetStorageIncomplete.insert(chunk).second)
+                        {
+                            targetStorageIncomplete.insert(chunk);
+                        }
+
+                        if(forBuffer && _index._bufferStorageIncomplete.insert(chunk).second)
+                        {
+                            bufferStorageIncomplete.insert(chunk);
+                        }
+                    }
+                }
+            }
+        }
+
         // notify target
         for(const Oid& oid : targetCatalogIncomplete) _onTargetCatalogIncomplete.in(oid);
         for(const Oid& oid : targetCatalogComplete  ) _onTargetCatalogComplete  .in(oid);
@@ -953,6 +1365,9 @@ namespace dci::aup
         for(const Oid& oid : bufferCatalogComplete  ) _onBufferCatalogComplete  .in(oid);
         for(const Oid& oid : bufferStorageIncomplete) _onBufferStorageIncomplete.in(oid);
         for(const Oid& oid : bufferStorageComplete  ) _onBufferStorageComplete  .in(oid);
+
+        completeReadyDeltas(verbose);
+        completeReadyChunked(verbose);
     }
 
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
@@ -1004,6 +1419,17 @@ namespace dci::aup
     Instance::Index Instance::buildIndex()
     {
         Index res;
+        _deltaByContent.clear();
+        _readyDeltas.clear();
+        _readyChunked.clear();
+
+        _chunkedByChunk.clear();
+        _chunkedByTarget.clear();
+        _chunkSources.clear();
+        for(const Oid& oid : _catalog.enumerate(catalog::Object::Type::chunked))
+        {
+            indexChunked(oid, catalog::objectPtrCast<catalog::Chunked>(_catalog.find(oid)));
+        }
 
         res._allReleases = _catalog.enumerate(catalog::Object::Type::release);
 
@@ -1013,7 +1439,7 @@ namespace dci::aup
             collectObjectsIndex(
                         _targetCriterias,
                         oid,
-                        r.get(),
+                        r,
                         res._targetCatalogIncomplete,
                         res._targetCatalogComplete,
                         res._targetStorageIncomplete,
@@ -1026,7 +1452,7 @@ namespace dci::aup
             collectObjectsIndex(
                         _bufferCriterias,
                         oid,
-                        r.get(),
+                        r,
                         res._bufferCatalogIncomplete,
                         res._bufferCatalogComplete,
                         res._bufferStorageIncomplete,
@@ -1037,7 +1463,7 @@ namespace dci::aup
     }
 
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
-    Set<std::pair<Oid, catalog::ReleasePtr>> Instance::collectMostReleases(
+    Set<std::pair<Oid, const catalog::Release*>> Instance::collectMostReleases(
             const std::vector<instance::Criteria>& criterias,
             const Set<Oid>& allReleases)
     {
@@ -1055,7 +1481,7 @@ namespace dci::aup
         struct Value
         {
             Oid                 _oid{};
-            catalog::ReleasePtr _r;
+            const catalog::Release* _r {};
             uint64              _srcMoment{};
         };
 
@@ -1063,14 +1489,14 @@ namespace dci::aup
 
         for(const Oid& oid : allReleases)
         {
-            catalog::ReleasePtr r = catalog::objectPtrCast<catalog::Release>(_catalog.get(oid));
+            const catalog::Release* r = catalog::objectPtrCast<catalog::Release>(_catalog.find(oid));
 
             if(!r)
             {
                 continue;
             }
 
-            if(!match(r.get(), criterias))
+            if(!match(r, criterias))
             {
                continue;
             }
@@ -1091,14 +1517,14 @@ namespace dci::aup
             {
                 prev._oid = oid;
                 prev._srcMoment = r->_srcMoment;
-                prev._r = std::move(r);
+                prev._r = r;
             }
         }
 
-        Set<std::pair<Oid, catalog::ReleasePtr>> res;
+        Set<std::pair<Oid, const catalog::Release*>> res;
         for(auto&[key, value] : mostReleases)
         {
-            res.insert(std::make_pair(value._oid, std::move(value._r)));
+            res.insert(std::make_pair(value._oid, value._r));
         }
 
         return res;
@@ -1107,7 +1533,7 @@ namespace dci::aup
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     void Instance::collectObjectsIndex(const std::vector<instance::Criteria>& criterias,
             const Oid& oid,
-            catalog::Object* o,
+            const catalog::Object* o,
             Set<Oid>& catalogIncomplete,
             Set<Oid>& catalogComplete,
             Set<Oid>& storageIncomplete,
@@ -1124,27 +1550,63 @@ namespace dci::aup
         {
             if(catalog::Object::Type::file == o->type())
             {
-                catalog::File* f = catalog::objectPtrCast<catalog::File>(o);
+                const catalog::File* f = catalog::objectPtrCast<catalog::File>(o);
+
+                Oid deltaOid;
+                const catalog::Delta* d = _storage.has(f->_content) ? nullptr : usableDelta(f, deltaOid);
+
+                Oid chunkedOid;
+                const catalog::Chunked* c = _storage.has(f->_content) || d ? nullptr : usableChunked(f, chunkedOid);
+                bool chunksReady = c && std::all_of(c->_chunks.begin(), c->_chunks.end(), [&](const Oid& chunk){return hasChunk(chunk);});
+
                 if(_storage.has(f->_content))
                 {
                     storageComplete.insert(f->_content);
                 }
+                else if(d)
+                {
+                    //вместо содержимого целиком запрашивается тело дельты к имеющейся базе,
+                    //уже имеющееся тело применяется после построения индекса в completeReadyDeltas
+                    _deltaByContent[d->_content] = deltaOid;
+                    storageIncomplete.insert(d->_content);
+                    if(_storage.has(d->_content))
+                    {
+                        _readyDeltas.insert(d->_content);
+                    }
+                }
+                else if(c && !chunksReady)
+                {
+                    //вместо содержимого целиком запрашиваются только недостающие куски
+                    for(const Oid& chunk : c->_chunks)
+                    {
+                        if(!hasChunk(chunk))
+                        {
+                            _chunkedByChunk[chunk].insert(chunkedOid);
+                            storageIncomplete.insert(chunk);
+                        }
+                    }
+                }
                 else
                 {
+                    //все куски уже есть - содержимое собирается после построения индекса в completeReadyChunked
+                    if(chunksReady)
+                    {
+                        _readyChunked.insert(chunkedOid);
+                    }
                     storageIncomplete.insert(f->_content);
                 }
             }
 
             for(const Oid& depOid : o->_dependencies)
             {
-                catalog::ObjectPtr depObject = _catalog.get(depOid);
+                const catalog::Object* depObject = _catalog.find(depOid);
                 if(!depObject)
                 {
                     catalogIncomplete.insert(depOid);
                     continue;
                 }
 
-                if(!match(depObject.get(), criterias))
+                if(!match(depObject, criterias))
                 {
                     catalogComplete.insert(depOid);
                     continue;
@@ -1153,7 +1615,7 @@ namespace dci::aup
                 collectObjectsIndex(
                             criterias,
                             depOid,
-                            depObject.get(),
+                            depObject,
                             catalogIncomplete,
                             catalogComplete,
                             storageIncomplete,
@@ -1163,6 +1625,422 @@ namespace dci::aup
         }
     }
 
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    const catalog::Delta* Instance::usableDelta(const catalog::File* f, Oid& deltaOid)
+    {
+        //первая из известных дельт файла, база которой уже есть в хранилище
+        for(const Oid& depOid : f->_dependencies)
+        {
+            const catalog::Delta* d = catalog::objectPtrCast<catalog::Delta>(_catalog.find(depOid));
+            if(d && d->_target == f->_content && d->_size == f->_size && _storage.has(d->_base))
+            {
+                deltaOid = depOid;
+                return d;
+            }
+        }
+
+        return nullptr;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    bool Instance::reconstructByDelta(const catalog::Delta* d)
+    {
+        try
+        {
+            std::optional<storage::Mapping> base = _storage.map(d->_base);
+            std::optional<storage::Mapping> delta = _storage.map(d->_content);
+            if(!base || !delta)
+            {
+                return false;
+            }
+
+            //восстановленное пишется во временный файл хранилища и хэшируется по ходу
+            Reconstruction out{_storage.tmpFile()};
+            catalog::applyDelta(base->data(), base->size(), delta->data(), delta->size(), [&](const uint8* data, uint64 size)
+            {
+                out.write(data, size);
+            });
+
+            if(out.size() != d->_size || out.finish() != d->_target)
+            {
+                LOGW("delta reconstruction mismatch: "<<utils::b2h(d->_target));
+                return false;
+            }
+
+            putReconstructed(d->_target, out.file());
+
+            return true;
+        }
+        catch(...)
+        {
+            LOGW("delta reconstruction failed: "<<utils::b2h(d->_target)<<", "<<dci::exception::toString(std::current_exception()));
+        }
+
+        return false;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Instance::completeReadyDeltas(bool verbose)
+    {
+        //тела дельт, найденные в хранилище при построении индекса, завершаются так же, как пришедшие извне
+        Set<Oid> ready;
+        ready.swap(_readyDeltas);
+
+        for(const Oid& deltaContent : ready)
+        {
+            if(!_deltaByContent.count(deltaContent))
+            {
+                continue;
+            }
+
+            completeByDelta(deltaContent);
+            updateIndexAfterStorageObjectComplete(verbose, deltaContent);
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Instance::completeByDelta(const Oid& deltaContent)
+    {
+        auto iter = _deltaByContent.find(deltaContent);
+        if(_deltaByContent.end() == iter)
+        {
+            return;
+        }
+
+        const catalog::Delta* d = catalog::objectPtrCast<catalog::Delta>(_catalog.find(iter->second));
+        _deltaByContent.erase(iter);
+        if(!d)
+        {
+            return;
+        }
+
+        bool forTarget = _index._targetStorageIncomplete.count(deltaContent);
+        bool forBuffer = _index._bufferStorageIncomplete.count(deltaContent);
+
+        if(_storage.has(d->_target) || reconstructByDelta(d))
+        {
+            if(forTarget && _index._targetStorageComplete.insert(d->_target).second) _onTargetStorageComplete.in(d->_target);
+            if(forBuffer && _index._bufferStorageComplete.insert(d->_target).second) _onBufferStorageComplete.in(d->_target);
+            return;
+        }
+
+        //дельта не сошлась, содержимое запрашивается целиком
+        if(forTarget && _index._targetStorageIncomplete.insert(d->_target).second) _onTargetStorageIncomplete.in(d->_target);
+        if(forBuffer && _index._bufferStorageIncomplete.insert(d->_target).second) _onBufferStorageIncomplete.in(d->_target);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    const catalog::Chunked* Instance::usableChunked(const catalog::File* f, Oid& chunkedOid)
+    {
+        for(const Oid& depOid : f->_dependencies)
+        {
+            const catalog::Chunked* c = catalog::objectPtrCast<catalog::Chunked>(_catalog.find(depOid));
+            if(c && c->_target == f->_content && c->_size == f->_size && usableChunked(c))
+            {
+                chunkedOid = depOid;
+                return c;
+            }
+        }
+
+        return nullptr;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    bool Instance::usableChunked(const catalog::Chunked* c)
+    {
+        if(c->_chunks.size() != c->_chunkSizes.size())
+        {
+            return false;
+        }
+
+        uint64 size{};
+        for(uint64 chunkSize : c->_chunkSizes)
+        {
+            size += chunkSize;
+        }
+
+        if(size != c->_size)
+        {
+            return false;
+        }
+
+        //выгода только если часть кусков уже есть
+        return std::any_of(c->_chunks.begin(), c->_chunks.end(), [&](const Oid& chunk){return hasChunk(chunk);});
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Instance::indexChunked(const Oid& oid, const catalog::Chunked* c)
+    {
+        if(!c)
+        {
+            return;
+        }
+
+        _chunkedByTarget[c->_target].insert(oid);
+
+        if(_storage.has(c->_target))
+        {
+            addChunkSources(c->_target);
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Instance::addChunkSources(const Oid& content)
+    {
+        for(const catalog::Chunked* c : chunkedFor(content))
+        {
+            uint64 offset{};
+            for(std::size_t i{}; i<c->_chunks.size(); ++i)
+            {
+                _chunkSources.emplace(c->_chunks[i], ChunkSource{content, offset, c->_chunkSizes[i]});
+                offset += c->_chunkSizes[i];
+            }
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    bool Instance::hasChunk(const Oid& chunk)
+    {
+        return _storage.has(chunk) || _chunkSources.count(chunk);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    std::optional<Bytes> Instance::getChunk(const Oid& chunk, uint64 offset, uint64 size)
+    {
+        std::optional<Bytes> res = _storage.get(chunk, offset, size);
+        if(res)
+        {
+            return res;
+        }
+
+        auto iter = _chunkSources.find(chunk);
+        if(_chunkSources.end() == iter)
+        {
+            return res;
+        }
+
+        const ChunkSource& src = iter->second;
+        offset = std::min(offset, src._size);
+        size = std::min(size, src._size - offset);
+
+        res = _storage.get(src._content, src._offset + offset, size);
+        if(res && res->size() != size)
+        {
+            //содержимое короче, чем обещано нарезкой
+            res.reset();
+        }
+
+        return res;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    bool Instance::reconstructByChunks(const catalog::Chunked* c)
+    {
+        try
+        {
+            //в памяти не более одного куска
+            Reconstruction out{_storage.tmpFile()};
+
+            for(std::size_t i{}; i<c->_chunks.size(); ++i)
+            {
+                std::optional<Bytes> chunk = getChunk(c->_chunks[i]);
+                if(!chunk || chunk->size() != c->_chunkSizes[i])
+                {
+                    return false;
+                }
+
+                bytes::Cursor cursor{chunk->begin()};
+                while(!cursor.atEnd())
+                {
+                    out.write(cursor.continuousData(), cursor.continuousDataSize());
+                    cursor.advanceChunks(1);
+                }
+            }
+
+            if(out.size() != c->_size || out.finish() != c->_target)
+            {
+                LOGW("chunks reconstruction mismatch: "<<utils::b2h(c->_target));
+                return false;
+            }
+
+            putReconstructed(c->_target, out.file());
+            return true;
+        }
+        catch(...)
+        {
+            LOGW("chunks reconstruction failed: "<<utils::b2h(c->_target)<<", "<<dci::exception::toString(std::current_exception()));
+        }
+
+        return false;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Instance::putReconstructed(const Oid& target, std::FILE* content)
+    {
+        _storage.batchBegin();
+        _storage.put(target, content);
+        if(!_storageFlushTicker.started())
+        {
+            _storageFlushTicker.start();
+        }
+        addChunkSources(target);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Instance::completeReadyChunked(bool verbose)
+    {
+        //нарезки, все куски которых нашлись при построении индекса, несобранное остается запрошенным целиком
+        Set<Oid> ready;
+        ready.swap(_readyChunked);
+
+        for(const Oid& chunkedOid : ready)
+        {
+            const catalog::Chunked* c = catalog::objectPtrCast<catalog::Chunked>(_catalog.find(chunkedOid));
+            if(!c)
+            {
+                continue;
+            }
+
+            bool wanted = _index._targetStorageIncomplete.count(c->_target) || _index._bufferStorageIncomplete.count(c->_target);
+            if(!wanted || !std::all_of(c->_chunks.begin(), c->_chunks.end(), [&](const Oid& chunk){return hasChunk(chunk);}))
+            {
+                continue;
+            }
+
+            if(_storage.has(c->_target) || reconstructByChunks(c))
+            {
+                updateIndexAfterStorageObjectComplete(verbose, c->_target);
+            }
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Instance::completeByChunk(const Oid& chunk)
+    {
+        auto iter = _chunkedByChunk.find(chunk);
+        if(_chunkedByChunk.end() == iter)
+        {
+            return;
+        }
+
+        Set<Oid> waiting = std::move(iter->second);
+        _chunkedByChunk.erase(iter);
+
+        bool forTarget = _index._targetStorageIncomplete.count(chunk);
+        bool forBuffer = _index._bufferStorageIncomplete.count(chunk);
+
+        for(const Oid& chunkedOid : waiting)
+        {
+            const catalog::Chunked* c = catalog::objectPtrCast<catalog::Chunked>(_catalog.find(chunkedOid));
+            if(!c || !std::all_of(c->_chunks.begin(), c->_chunks.end(), [&](const Oid& part){return hasChunk(part);}))
+            {
+                //ждет и другие куски
+                continue;
+            }
+
+            if(_storage.has(c->_target) || reconstructByChunks(c))
+            {
+                if(forTarget && _index._targetStorageComplete.insert(c->_target).second) _onTargetStorageComplete.in(c->_target);
+                if(forBuffer && _index._bufferStorageComplete.insert(c->_target).second) _onBufferStorageComplete.in(c->_target);
+                continue;
+            }
+
+            //не сошлось, содержимое запрашивается целиком
+            if(forTarget && _index._targetStorageIncomplete.insert(c->_target).second) _onTargetStorageIncomplete.in(c->_target);
+            if(forBuffer && _index._bufferStorageIncomplete.insert(c->_target).second) _onBufferStorageIncomplete.in(c->_target);
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    std::vector<const catalog::Chunked*> Instance::chunkedFor(const Oid& content)
+    {
+        std::vector<const catalog::Chunked*> res;
+
+        auto iter = _chunkedByTarget.find(content);
+        if(_chunkedByTarget.end() == iter)
+        {
+            return res;
+        }
+
+        for(const Oid& oid : iter->second)
+        {
+            const catalog::Chunked* c = catalog::objectPtrCast<catalog::Chunked>(_catalog.find(oid));
+            if(c && c->_chunks.size() == c->_chunkSizes.size())
+            {
+                res.push_back(c);
+            }
+        }
+
+        return res;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    bool Instance::verifyRange(const catalog::Chunked* c, uint64 offset, const Bytes& blob, std::size_t& first)
+    {
+        //начало диапазона - на границе куска
+        std::size_t index{};
+        uint64 chunkOffset{};
+        while(index < c->_chunkSizes.size() && chunkOffset < offset)
+        {
+            chunkOffset += c->_chunkSizes[index];
+            ++index;
+        }
+
+        if(chunkOffset != offset || !blob.size())
+        {
+            return false;
+        }
+
+        first = index;
+
+        //конец - тоже на границе, каждый кусок хэшируется прямо по сегментам blob
+        bytes::Cursor cursor{blob.begin()};
+        const uint8* segment{};
+        uint64 segmentSize{};
+
+        for(uint64 pos{}; pos < blob.size(); ++index)
+        {
+            if(index >= c->_chunkSizes.size())
+            {
+                return false;
+            }
+
+            uint64 size = c->_chunkSizes[index];
+            if(size > blob.size() - pos)
+            {
+                return false;
+            }
+
+            crypto::Blake3 hashier{32};
+            for(uint64 left{size}; left; )
+            {
+                if(!segmentSize)
+                {
+                    segment = static_cast<const uint8*>(cursor.continuousData());
+                    segmentSize = cursor.continuousDataSize();
+                    cursor.advanceChunks(1);
+                }
+
+                uint64 portion = std::min(left, segmentSize);
+                hashier.add(segment, portion);
+                segment += portion;
+                segmentSize -= portion;
+                left -= portion;
+            }
+
+            Oid chunk;
+            hashier.finish(chunk.data());
+            if(chunk != c->_chunks[index])
+            {
+                return false;
+            }
+
+            pos += size;
+        }
+
+        return true;
+    }
+
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     bool Instance::match(const auto* catalogObject, const std::vector<instance::Criteria>& criterias)
     {
@@ -11,8 +11,11 @@
 #include "instance/criteria.hpp"
 #include "impl/catalog.hpp"
 #include "impl/storage.hpp"
+#include "impl/targetWatcher.hpp"
 #include <dci/poll/timer.hpp>
 #include <dci/aup/applier/result.hpp>
+#include <dci/aup/catalog/delta.hpp>
+#include <dci/aup/catalog/chunked.hpp>
 #include <dci/aup/instance/io.hpp>
 
 namespace dci::aup
@@ -28,6 +31,7 @@ namespace dci::aup
 
     public://setup
         void start(const std::vector<std::string>& args);
+        void start(const boost::property_tree::ptree& config);
         void stop();
 
         bool targetComplete();
@@ -73,20 +77,26 @@ namespace dci::aup
         bool hasStorageObject(const Oid& oid);
 
         std::optional<Bytes> getCatalogObject(const Oid& oid);
-        std::optional<Bytes> getStorageObject(const Oid& oid, uint32 offset=0, uint32 size=~uint32{});
+        std::optional<Bytes> getStorageObject(const Oid& oid, uint64 offset=0, uint64 size=~uint64{});
+        std::optional<storage::Mapping> mapStorageObject(const Oid& oid);
 
         instance::io::PutObjectResult putCatalogObject(const Oid& oid, Bytes&& blob);
         instance::io::PutObjectResult putStorageObject(const Oid& oid, Bytes&& blob);
         instance::io::PutObjectResult putStorageObject(const Oid& oid, instance::io::StdFilePtr f);
 
+        std::vector<uint64> storageObjectChunks(const Oid& oid);
+        bool verifyStorageObjectRange(const Oid& oid, uint64 offset, const Bytes& blob);
+        instance::io::PutObjectResult putStorageObjectRange(const Oid& oid, uint64 offset, Bytes&& blob);
+
     private:
         void loadCatalog();
         void saveCatalog(bool force = true);
+        void flushStorage(bool force = true);
 
     private:
         using Roots = Map<Oid, Set<catalog::File::Kind>>;
         Roots collectRoots4UpdateTarget();
-        void collectRequireds(const Oid& oid, Set<Oid>& requiredsCatalog, Set<Oid>& requiredsStorage);
+        void collectRequireds(const Oid& oid, impl::OidInterner& oids, impl::HandleSet& requiredsCatalog, impl::HandleSet& requiredsStorage);
 
     private:
         struct Index;
@@ -97,24 +107,47 @@ namespace dci::aup
         void updateIndexAfterStorageObjectComplete(bool verbose, const Oid& oid);
 
         Index buildIndex();
-        Set<std::pair<Oid, catalog::ReleasePtr>> collectMostReleases(
+        Set<std::pair<Oid, const catalog::Release*>> collectMostReleases(
                 const std::vector<instance::Criteria>& criterias,
                 const Set<Oid>& allReleases);
         void collectObjectsIndex(const std::vector<instance::Criteria>& criterias,
                 const Oid& oid,
-                catalog::Object* o,
+                const catalog::Object* o,
                 Set<Oid>& catalogIncomplete,
                 Set<Oid>& catalogComplete,
                 Set<Oid>& storageIncomplete,
                 Set<Oid>& storageComplete,
                 const Set<Oid>* globalCatalogComplete = nullptr);
 
+    private:
+        const catalog::Delta* usableDelta(const catalog::File* f, Oid& deltaOid);
+        bool reconstructByDelta(const catalog::Delta* d);
+        void completeReadyDeltas(bool verbose);
+        void completeByDelta(const Oid& deltaContent);
+
+        const catalog::Chunked* usableChunked(const catalog::File* f, Oid& chunkedOid);
+        bool usableChunked(const catalog::Chunked* c);
+        void indexChunked(const Oid& oid, const catalog::Chunked* c);
+        void addChunkSources(const Oid& content);
+        bool hasChunk(const Oid& chunk);
+        std::optional<Bytes> getChunk(const Oid& chunk, uint64 offset=0, uint64 size=~uint64{});
+        bool reconstructByChunks(const catalog::Chunked* c);
+        void completeReadyChunked(bool verbose);
+        void putReconstructed(const Oid& target, std::FILE* content);
+        void completeByChunk(const Oid& chunk);
+
+        std::vector<const catalog::Chunked*> chunkedFor(const Oid& content);
+        bool verifyRange(const catalog::Chunked* c, uint64 offset, const Bytes& blob, std::size_t& first);
+
     private:
         bool match(const auto* catalogObject, const std::vector<instance::Criteria>& criterias);
         bool match(const auto* catalogObject, bool onlyTargetCriteria);
 
     private:
         std::filesystem::path           _targetDir;
+        bool                            _targetParanoid {};//содержимое цели пересчитывается всегда, без кэша состояния
+        impl::TargetWatcher             _targetWatcher;//измененное в цели между применениями
+        poll::Timer                     _targetWatchTicker{std::chrono::seconds{1}, true, [this]{_targetWatcher.drain();}};
         std::vector<instance::Criteria> _targetCriterias;
         std::vector<instance::Criteria> _bufferCriterias;
 
@@ -123,10 +156,27 @@ namespace dci::aup
 
     private:
         impl::Catalog   _catalog;
+        uint64          _catalogCheckpointSize {};//размер полного снимка, 0 - снимка нет или журнал к нему не применим
+        uint64          _catalogJournalSize {};
         poll::Timer     _catalogSaveTicker{std::chrono::seconds{1}, false, [this]{saveCatalog(true);}};
 
     private:
-        impl::Storage _storage;
+        impl::Storage   _storage;
+        poll::Timer     _storageFlushTicker{std::chrono::seconds{1}, false, [this]{flushStorage(true);}};
+        Map<Oid, Oid>   _deltaByContent;//тело дельты, запрошенное вместо содержимого -> объект дельты
+        Set<Oid>        _readyDeltas;//тела дельт, уже имеющиеся в хранилище и ждущие completeReadyDeltas
+
+        struct ChunkSource
+        {
+            Oid     _content {};
+            uint64  _offset {};
+            uint64  _size {};
+        };
+
+        Map<Oid, Set<Oid>>      _chunkedByChunk;//кусок, запрошенный вместо содержимого -> ожидающие его нарезки
+        Map<Oid, Set<Oid>>      _chunkedByTarget;//содержимое -> все его нарезки
+        Map<Oid, ChunkSource>   _chunkSources;//кусок -> его место в имеющемся содержимом
+        Set<Oid>                _readyChunked;//нарезки со всеми кусками, ждущие completeReadyChunked
 
     private:
         sbs::Wire<void, Oid>                _onNewReleaseFound;
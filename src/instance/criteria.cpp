@@ -333,6 +333,10 @@ namespace dci::aup::instance
             return match(aup::catalog::objectPtrCast<aup::catalog::Unit>(o));
         case aup::catalog::Object::Type::file:
             return match(aup::catalog::objectPtrCast<aup::catalog::File>(o));
+        case aup::catalog::Object::Type::delta:
+        case aup::catalog::Object::Type::chunked:
+            //собственных признаков нет, отбирается вместе с файлом
+            return true;
         default:
             break;
         }
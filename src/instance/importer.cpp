@@ -9,6 +9,7 @@
 #include "../impl/catalog.hpp"
 #include "../impl/catalog/serializeObject.hpp"
 #include "../impl/storage.hpp"
+#include "../impl/metaPaths.hpp"
 #include <dci/aup/catalog/identify.hpp>
 #include <dci/utils/b2h.hpp>
 #include <dci/utils/atScopeExit.hpp>
@@ -163,7 +164,7 @@ namespace dci::aup::instance
 
             Storage s;
             s.reset(path.string(), false);
-            std::optional<Bytes> catalogBlob = s.get("catalog");
+            std::optional<Bytes> catalogBlob = s.get(impl::g_catalogPath);
             if(!catalogBlob)
             {
                 LOGE("importer: no catalog found");
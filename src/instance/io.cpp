@@ -116,12 +116,19 @@ namespace dci::aup::instance::io
     }
 
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
-    std::optional<Bytes> getStorageObject(const Oid& oid, uint32 offset, uint32 size)
+    std::optional<Bytes> getStorageObject(const Oid& oid, uint64 offset, uint64 size)
     {
         if(!g_instance) throw aup::Exception{"instance uninitialized"};
         return g_instance->getStorageObject(oid, offset, size);
     }
 
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    std::optional<storage::Mapping> mapStorageObject(const Oid& oid)
+    {
+        if(!g_instance) throw aup::Exception{"instance uninitialized"};
+        return g_instance->mapStorageObject(oid);
+    }
+
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     PutObjectResult putCatalogObject(const Oid& oid, Bytes&& blob)
     {
@@ -142,4 +149,25 @@ namespace dci::aup::instance::io
         if(!g_instance) throw aup::Exception{"instance uninitialized"};
         return g_instance->putStorageObject(oid, std::move(f));
     }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    std::vector<uint64> storageObjectChunks(const Oid& oid)
+    {
+        if(!g_instance) throw aup::Exception{"instance uninitialized"};
+        return g_instance->storageObjectChunks(oid);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    bool verifyStorageObjectRange(const Oid& oid, uint64 offset, const Bytes& blob)
+    {
+        if(!g_instance) throw aup::Exception{"instance uninitialized"};
+        return g_instance->verifyStorageObjectRange(oid, offset, blob);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    PutObjectResult putStorageObjectRange(const Oid& oid, uint64 offset, Bytes&& blob)
+    {
+        if(!g_instance) throw aup::Exception{"instance uninitialized"};
+        return g_instance->putStorageObjectRange(oid, offset, std::move(blob));
+    }
 }
@@ -32,6 +32,34 @@ namespace dci::aup::instance::setup
         }
     }
 
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void start(const boost::property_tree::ptree& config)
+    {
+        if(g_instance)
+        {
+            throw aup::Exception{"instance already initialized"};
+        }
+
+        g_instance.reset(new Instance);
+
+        try
+        {
+            g_instance->start(config);
+        }
+        catch(...)
+        {
+            g_instance.reset();
+            throw;
+        }
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void stop()
+    {
+        if(!g_instance) throw aup::Exception{"instance uninitialized"};
+        g_instance.reset();
+    }
+
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     bool targetComplete()
     {
@@ -22,9 +22,27 @@ namespace dci::aup
     }
 
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
-    void Storage::reset(const std::string& place, bool autoFixIfCan)
+    void Storage::reset(const std::string& place, bool autoFixIfCan, bool packed, bool compressed)
     {
-        return impl().reset(place, autoFixIfCan);
+        return impl().reset(place, autoFixIfCan, packed, compressed);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    uint64 Storage::compact()
+    {
+        return impl().compact();
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Storage::batchBegin()
+    {
+        return impl().batchBegin();
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Storage::batchCommit()
+    {
+        return impl().batchCommit();
     }
 
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
@@ -46,11 +64,17 @@ namespace dci::aup
     }
 
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
-    std::optional<Bytes> Storage::get(const std::string& localPath, uint32 from, uint32 to)
+    std::optional<Bytes> Storage::get(const std::string& localPath, uint64 from, uint64 to)
     {
         return impl().get(localPath, from, to);
     }
 
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    std::optional<storage::Mapping> Storage::map(const std::string& localPath)
+    {
+        return impl().map(localPath);
+    }
+
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     bool Storage::del(const std::string& localPath)
     {
@@ -70,11 +94,17 @@ namespace dci::aup
     }
 
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
-    std::optional<Bytes> Storage::get(const Oid& oid, uint32 from, uint32 to)
+    std::optional<Bytes> Storage::get(const Oid& oid, uint64 from, uint64 to)
     {
         return impl().get(oid, from, to);
     }
 
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    std::optional<storage::Mapping> Storage::map(const Oid& oid)
+    {
+        return impl().map(oid);
+    }
+
     /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
     bool Storage::del(const Oid& oid)
     {
@@ -0,0 +1,208 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+#include <dci/aup/storage/mapping.hpp>
+#include <dci/utils/atScopeExit.hpp>
+#include <system_error>
+#include <utility>
+
+#ifdef _WIN32
+#   include <cstdio>
+#   include <cstdlib>
+#else
+#   include <cstdlib>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <fcntl.h>
+#   include <unistd.h>
+#endif
+
+namespace dci::aup::storage
+{
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    Mapping::Mapping()
+    {
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    Mapping::Mapping(Mapping&& from)
+        : _base{std::exchange(from._base, nullptr)}
+        , _baseSize{std::exchange(from._baseSize, 0)}
+        , _data{std::exchange(from._data, nullptr)}
+        , _size{std::exchange(from._size, 0)}
+        , _owned{std::exchange(from._owned, false)}
+    {
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    Mapping::~Mapping()
+    {
+        close();
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    Mapping& Mapping::operator=(Mapping&& from)
+    {
+        if(this != &from)
+        {
+            close();
+            _base = std::exchange(from._base, nullptr);
+            _baseSize = std::exchange(from._baseSize, 0);
+            _data = std::exchange(from._data, nullptr);
+            _size = std::exchange(from._size, 0);
+            _owned = std::exchange(from._owned, false);
+        }
+
+        return *this;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Mapping::open(const std::filesystem::path& path, uint64 offset, uint64 size)
+    {
+        close();
+
+#ifdef _WIN32
+        std::FILE* in = _wfopen(path.c_str(), L"rb");
+        if(!in)
+        {
+            throw std::system_error(errno, std::generic_category(), "unable to open "+path.string());
+        }
+        utils::AtScopeExit se = {[&]{fclose(in);}};
+
+        uint64 fileSize = std::filesystem::file_size(path);
+        if(offset > fileSize) offset = fileSize;
+        if(size > fileSize - offset) size = fileSize - offset;
+
+        if(!size)
+        {
+            return;
+        }
+
+        if(_fseeki64(in, static_cast<int64>(offset), SEEK_SET))
+        {
+            throw std::system_error(errno, std::generic_category(), "unable to seek "+path.string());
+        }
+
+        _base = std::malloc(static_cast<std::size_t>(size));
+        if(!_base)
+        {
+            throw std::system_error(ENOMEM, std::generic_category(), "unable to map "+path.string());
+        }
+        _baseSize = static_cast<std::size_t>(size);
+
+        if(_baseSize != fread(_base, 1, _baseSize, in))
+        {
+            close();
+            throw std::system_error(errno ? errno : EIO, std::generic_category(), "unable to read "+path.string());
+        }
+
+        _data = static_cast<const uint8*>(_base);
+        _size = size;
+#else
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if(0 > fd)
+        {
+            throw std::system_error(errno, std::generic_category(), "unable to open "+path.string());
+        }
+        utils::AtScopeExit se = {[&]{::close(fd);}};
+
+        struct stat st;
+        if(fstat(fd, &st))
+        {
+            throw std::system_error(errno, std::generic_category(), "unable to stat "+path.string());
+        }
+
+        uint64 fileSize = static_cast<uint64>(st.st_size);
+        if(offset > fileSize) offset = fileSize;
+        if(size > fileSize - offset) size = fileSize - offset;
+
+        if(!size)
+        {
+            return;
+        }
+
+        uint64 page = static_cast<uint64>(sysconf(_SC_PAGESIZE));
+        uint64 alignedOffset = offset - offset % page;
+
+        std::size_t baseSize = static_cast<std::size_t>(size + (offset - alignedOffset));
+        void* base = mmap(nullptr, baseSize, PROT_READ, MAP_SHARED, fd, static_cast<off_t>(alignedOffset));
+        if(MAP_FAILED == base)
+        {
+            throw std::system_error(errno, std::generic_category(), "unable to map "+path.string());
+        }
+
+        posix_madvise(base, baseSize, POSIX_MADV_SEQUENTIAL);
+
+        _base = base;
+        _baseSize = baseSize;
+        _data = static_cast<const uint8*>(base) + (offset - alignedOffset);
+        _size = size;
+#endif
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    void Mapping::close()
+    {
+        if(_base)
+        {
+#ifdef _WIN32
+            std::free(_base);
+#else
+            if(_owned)
+            {
+                std::free(_base);
+            }
+            else
+            {
+                munmap(_base, _baseSize);
+            }
+#endif
+        }
+
+        _base = nullptr;
+        _baseSize = 0;
+        _data = nullptr;
+        _size = 0;
+        _owned = false;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    uint8* Mapping::allocate(uint64 size)
+    {
+        close();
+
+        if(!size)
+        {
+            return nullptr;
+        }
+
+        _base = std::malloc(static_cast<std::size_t>(size));
+        if(!_base)
+        {
+            throw std::system_error(ENOMEM, std::generic_category(), "unable to allocate mapping");
+        }
+
+        _baseSize = static_cast<std::size_t>(size);
+        _owned = true;
+        _data = static_cast<const uint8*>(_base);
+        _size = size;
+
+        return static_cast<uint8*>(_base);
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    const uint8* Mapping::data() const
+    {
+        return _data;
+    }
+
+    /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+    uint64 Mapping::size() const
+    {
+        return _size;
+    }
+}
@@ -10,6 +10,87 @@
 using namespace dci::aup;
 using namespace dci;
 
+#include <dci/utils/b2h.hpp>
+#include <dci/crypto.hpp>
+#include <filesystem>
+#include <set>
+#include <functional>
+
+namespace
+{
+    //временное место с каталогом и хранилищем, удаляется вместе со всем содержимым
+    struct Stand
+    {
+        std::filesystem::path   _place = std::filesystem::temp_directory_path() / utils::b2h(crypto::rnd::generate(32));
+        Storage                 _storage;
+        Catalog                 _catalog;
+
+        Stand()
+        {
+            _storage.reset((_place / "storage").string());
+        }
+
+        ~Stand()
+        {
+            std::filesystem::remove_all(_place);
+        }
+
+        //файл в каталог, содержимое в хранилище
+        Oid addFile(const std::string& path, const std::string& text)
+        {
+            Bytes blob;
+            blob.end().write(text.data(), static_cast<uint32>(text.size()));
+
+            catalog::FilePtr f{new catalog::File};
+            f->_kind = catalog::File::Kind::cmm;
+            f->_path = path;
+            f->_perms = 0644;
+            f->_size = text.size();
+            f->_content = catalog::identify(blob);
+            _storage.put(f->_content, std::move(blob));
+
+            return _catalog.put(std::move(f));
+        }
+
+        void attach(Applier& a)
+        {
+            a.addCatalog(&_catalog);
+            a.addStorage(&_storage);
+        }
+    };
+
+    //пустой файл, вместе с недостающими каталогами
+    void touch(const std::filesystem::path& path)
+    {
+        std::filesystem::create_directories(path.parent_path());
+        std::fclose(std::fopen(path.string().c_str(), "w"));
+    }
+
+    //дерево места: каталоги со слешем, ссылки с целью, файлы с размером
+    std::set<std::string> listing(const std::filesystem::path& target)
+    {
+        std::set<std::string> res;
+        for(const auto& e : std::filesystem::recursive_directory_iterator(target))
+        {
+            std::string item = e.path().lexically_relative(target).generic_string();
+            if(e.is_symlink())
+            {
+                item += " -> " + std::filesystem::read_symlink(e.path()).string();
+            }
+            else if(e.is_directory())
+            {
+                item += "/";
+            }
+            else
+            {
+                item += " " + std::to_string(e.file_size());
+            }
+            res.insert(item);
+        }
+        return res;
+    }
+}
+
 /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
 TEST(aup, applier)
 {
@@ -32,3 +113,287 @@ TEST(aup, applier)
 
 //    a.process("..", applier::tAll);
 }
+
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(aup, applier_plan)
+{
+    Stand stand;
+    Applier a;
+    stand.attach(a);
+
+    for(int i{}; i<3; ++i)
+    {
+        a.addRoot(stand.addFile("dir/file" + std::to_string(i), "content " + std::to_string(i)), {catalog::File::Kind::cmm});
+    }
+
+    const std::string target = (stand._place / "target").string();
+    const applier::Task task = static_cast<applier::Task>(applier::tEmplaceMissings | applier::tEmplaceChanges | applier::tRemoveExtra);
+
+    //план не трогает место
+    applier::Plan p = a.plan(target, task);
+    EXPECT_FALSE(std::filesystem::exists(target));
+    EXPECT_EQ(p._actions.size(), 3u);
+    EXPECT_EQ(p.bytes(), 3u*9);
+
+    //переживает сериализацию
+    applier::Plan p2 = applier::deserialize(applier::serialize(p));
+    EXPECT_EQ(p2._actions.size(), p._actions.size());
+    EXPECT_EQ(p2._place, p._place);
+
+    EXPECT_EQ(a.execute(p2), applier::rFixedMissings);
+    EXPECT_TRUE(a.plan(target, task)._actions.empty());
+    EXPECT_EQ(a.process(target, task), applier::rOk);
+}
+
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(aup, applier_planUntrusted)
+{
+    Stand stand;
+    Applier a;
+    stand.attach(a);
+    a.setStatCache(&stand._storage, "target.stat");
+    a.addRoot(stand.addFile("dir/file", "content"), {catalog::File::Kind::cmm});
+
+    const std::string target = (stand._place / "target").string();
+    const applier::Task task = static_cast<applier::Task>(applier::tEmplaceMissings | applier::tEmplaceChanges | applier::tRemoveExtra);
+
+    //неисполненный план ничего не сохраняет
+    applier::Plan p = a.plan(target, task);
+    EXPECT_FALSE(stand._storage.has("target.stat"));
+
+    //пути за пределы места отвергаются до любых изменений
+    for(const char* bad : {"../escape", "dir/../../escape", "/escape", ""})
+    {
+        applier::Plan tampered = applier::deserialize(applier::serialize(p));
+        tampered._actions.back()._path = bad;
+        EXPECT_THROW(a.execute(tampered), aup::Exception);
+
+        tampered = applier::deserialize(applier::serialize(p));
+        tampered._dirs.push_back(bad);
+        EXPECT_THROW(a.execute(tampered), aup::Exception);
+    }
+    EXPECT_FALSE(std::filesystem::exists(target));
+    EXPECT_FALSE(std::filesystem::exists(stand._place / "escape"));
+
+    EXPECT_EQ(a.execute(p), applier::rFixedMissings);
+    EXPECT_TRUE(stand._storage.has("target.stat"));
+}
+
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(aup, applier_shadow)
+{
+    Stand stand;
+
+    const std::filesystem::path target = stand._place / "target";
+    const applier::Task task = static_cast<applier::Task>(applier::tEmplaceMissings | applier::tEmplaceChanges | applier::tRemoveExtra | applier::tShadow);
+
+    Applier first;
+    stand.attach(first);
+    first.addRoot(stand.addFile("a", "first a"), {catalog::File::Kind::cmm});
+    first.addRoot(stand.addFile("b", "first b"), {catalog::File::Kind::cmm});
+    EXPECT_EQ(first.process(target.string(), task), applier::rFixedMissings);
+
+    //b меняется, a переносится ссылкой
+    Applier a;
+    stand.attach(a);
+    a.addRoot(stand.addFile("a", "first a"), {catalog::File::Kind::cmm});
+    a.addRoot(stand.addFile("b", "second b"), {catalog::File::Kind::cmm});
+    EXPECT_EQ(a.process(target.string(), task), applier::rFixedChanges);
+    EXPECT_EQ(std::filesystem::file_size(target / "b"), 8u);
+    EXPECT_TRUE(std::filesystem::exists(stand._place / "target.aup-previous"));
+    EXPECT_EQ(std::filesystem::file_size(stand._place / "target.aup-previous" / "b"), 7u);
+    EXPECT_FALSE(std::filesystem::exists(stand._place / "target.aup-shadow"));
+
+    //откат возвращает прежнее дерево
+    EXPECT_TRUE(a.rollback(target.string()));
+    EXPECT_EQ(std::filesystem::file_size(target / "b"), 7u);
+}
+
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(aup, applier_shadowKeeps)
+{
+    Stand stand;
+
+    catalog::UnitPtr u{new catalog::Unit};
+    u->_name = "unit";
+    u->_dependencies.insert(stand.addFile("a", "content a"));
+    u->_dependencies.insert(stand.addFile("dir/b", "content b"));
+    u->_extraAllowed = {"keep", "keep/*"};
+    Oid root = stand._catalog.put(std::move(u));
+
+    //одно и то же дерево, на месте и через теневое
+    auto prepare = [&](const std::filesystem::path& target)
+    {
+        std::filesystem::create_directories(target / "keep/inner");
+        std::filesystem::create_directories(target / "drop/inner");
+        touch(target / "dir/b");
+        touch(target / "junk");
+        std::filesystem::create_symlink("a", target / "link");
+    };
+
+    const applier::Task task = static_cast<applier::Task>(applier::tEmplaceMissings | applier::tEmplaceChanges | applier::tRemoveExtra);
+
+    std::set<std::string> results[2];
+    for(int shadow : {0, 1})
+    {
+        std::filesystem::path target = stand._place / ("target" + std::to_string(shadow));
+        prepare(target);
+
+        Applier a;
+        stand.attach(a);
+        a.addRoot(root, {catalog::File::Kind::cmm});
+        a.process(target.string(), static_cast<applier::Task>(task | (shadow ? applier::tShadow : applier::tNull)));
+
+        results[shadow] = listing(target);
+    }
+
+    EXPECT_EQ(results[0], results[1]);
+    EXPECT_TRUE(results[1].count("link -> a"));
+    EXPECT_TRUE(results[1].count("keep/inner/"));
+    EXPECT_FALSE(results[1].count("drop/"));
+    EXPECT_FALSE(results[1].count("junk 0"));
+}
+
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(aup, applier_extraAllowed)
+{
+    Stand stand;
+    Applier a;
+    stand.attach(a);
+
+    catalog::UnitPtr u{new catalog::Unit};
+    u->_name = "unit";
+    u->_dependencies.insert(stand.addFile("bin/file", "content"));
+    u->_extraAllowed = {"var/*.log", "cache/[!x]*", "etc/local"};
+    a.addRoot(stand._catalog.put(std::move(u)), {catalog::File::Kind::cmm});
+
+    const std::filesystem::path target = stand._place / "target";
+    for(const char* extra : {"var/a.log", "var/a.txt", "var/sub/b.log", "cache/data", "cache/xdata", "etc/local", "etc/other"})
+    {
+        touch(target / extra);
+    }
+
+    const applier::Task task = static_cast<applier::Task>(applier::tEmplaceMissings | applier::tEmplaceChanges | applier::tRemoveExtra);
+    EXPECT_NE(a.process(target.string(), task) & applier::rFixedExtra, 0u);
+
+    EXPECT_TRUE(std::filesystem::exists(target / "bin/file"));
+    EXPECT_TRUE(std::filesystem::exists(target / "var/a.log"));
+    EXPECT_TRUE(std::filesystem::exists(target / "cache/data"));
+    EXPECT_TRUE(std::filesystem::exists(target / "etc/local"));
+    EXPECT_FALSE(std::filesystem::exists(target / "var/a.txt"));
+    EXPECT_FALSE(std::filesystem::exists(target / "var/sub"));
+    EXPECT_FALSE(std::filesystem::exists(target / "cache/xdata"));
+    EXPECT_FALSE(std::filesystem::exists(target / "etc/other"));
+}
+
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(aup, applier_dirty)
+{
+    Stand stand;
+
+    std::vector<Oid> roots;
+    for(int i{}; i<3; ++i)
+    {
+        roots.push_back(stand.addFile("dir/file" + std::to_string(i), "content " + std::to_string(i)));
+    }
+
+    const applier::Task keep = static_cast<applier::Task>(applier::tEmplaceMissings | applier::tEmplaceChanges);
+    const applier::Task task = static_cast<applier::Task>(keep | applier::tRemoveWrongs | applier::tRemoveExtra);
+
+    //одни и те же шаги: с известным измененным и с полной проверкой каждый раз
+    struct Step
+    {
+        applier::Task                       _task;
+        std::function<void(const std::filesystem::path&)> _change;
+        Set<String>                         _dirty;
+    };
+
+    const std::vector<Step> steps
+    {
+        //лишнее и неверное, оставленные без удаления, потом удаляются уже выборочным применением
+        {keep, [&](const std::filesystem::path& t){touch(t / "dir/extra"); std::filesystem::create_symlink("file0", t / "dir/link");}, {}},
+        {keep, [&](const std::filesystem::path&){}, {}},
+        {task, [&](const std::filesystem::path&){}, {}},
+        {task, [&](const std::filesystem::path& t){touch(t / "dir/extra");}, {"dir/extra"}},
+        {task, [&](const std::filesystem::path& t){std::filesystem::remove(t / "dir/file1");}, {"dir"}},
+        {task, [&](const std::filesystem::path&){}, {}},
+    };
+
+    std::vector<applier::Result> results[2];
+    std::set<std::string> trees[2];
+    for(int full : {0, 1})
+    {
+        std::filesystem::path target = stand._place / ("target" + std::to_string(full));
+
+        Applier a;
+        stand.attach(a);
+        a.setStatCache(&stand._storage, "target" + std::to_string(full) + ".stat");
+        for(const Oid& root : roots)
+        {
+            a.addRoot(root, {catalog::File::Kind::cmm});
+        }
+
+        for(const Step& step : steps)
+        {
+            step._change(target);
+            a.setDirty(full ? std::optional<Set<String>>{} : std::optional<Set<String>>{step._dirty});
+            results[full].push_back(a.process(target.string(), step._task));
+        }
+
+        trees[full] = listing(target);
+    }
+
+    EXPECT_TRUE(results[0] == results[1]);
+    EXPECT_TRUE(trees[0] == trees[1]);
+    EXPECT_EQ(results[0][0] & applier::rExistsExtra, applier::rExistsExtra);
+    EXPECT_EQ(results[0][1] & applier::rExistsExtra, applier::rExistsExtra);
+    EXPECT_NE(results[0][2] & applier::rFixedExtra, 0u);
+    EXPECT_EQ(results[0][3], applier::rFixedExtra);
+    EXPECT_EQ(results[0][4], applier::rFixedMissings);
+    EXPECT_EQ(results[0][5], applier::rOk);
+    EXPECT_FALSE(trees[0].count("dir/extra 0"));
+    EXPECT_FALSE(trees[0].count("dir/link -> file0"));
+    EXPECT_TRUE(trees[0].count("dir/file1 9"));
+}
+
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(aup, applier_dirtyInterrupted)
+{
+    Stand stand;
+
+    const std::filesystem::path target = stand._place / "target";
+    const applier::Task task = static_cast<applier::Task>(applier::tEmplaceMissings | applier::tEmplaceChanges | applier::tRemoveExtra);
+
+    Applier a;
+    stand.attach(a);
+    //без запаса на гранулярность времени - кэшу доверяется сразу, как после долгой паузы
+    a.setStatCache(&stand._storage, "target.stat", std::chrono::nanoseconds{0});
+    a.addRoot(stand.addFile("dir/file", "content"), {catalog::File::Kind::cmm});
+    EXPECT_EQ(a.process(target.string(), task), applier::rFixedMissings);
+
+    //изменение того же размера, о нем известно только как о грязном пути
+    {
+        std::FILE* f = std::fopen((target / "dir/file").string().c_str(), "wb");
+        std::fwrite("CONTENT", 1, 7, f);
+        std::fclose(f);
+    }
+
+    //применение прерывается исключением: каталог там, где лежит файл
+    touch(target / "blocked");
+
+    Applier b;
+    stand.attach(b);
+    b.setStatCache(&stand._storage, "target.stat", std::chrono::nanoseconds{0});
+    b.addRoot(stand.addFile("dir/file", "content"), {catalog::File::Kind::cmm});
+    b.addRoot(stand.addFile("blocked/file", "blocked"), {catalog::File::Kind::cmm});
+    b.setDirty(Set<String>{"dir/file"});
+    EXPECT_THROW(b.process(target.string(), task), std::exception);
+
+    //грязный путь потерян вместе с прерванным применением, но кэшу уже не доверяется
+    a.setDirty(Set<String>{});
+    EXPECT_NE(a.process(target.string(), task) & applier::rFixedChanges, 0u);
+
+    std::FILE* f = std::fopen((target / "dir/file").string().c_str(), "rb");
+    EXPECT_TRUE(catalog::identify(f) == catalog::identify("content", 7));
+    std::fclose(f);
+}
@@ -7,6 +7,7 @@
 
 #include <dci/test.hpp>
 #include <dci/aup.hpp>
+#include <algorithm>
 using namespace dci::aup;
 
 /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
@@ -14,14 +15,221 @@ TEST(aup, catalog_one)
 {
     Catalog i;
 
+    //за пределами 4 GiB
+    const dci::uint64 size = dci::uint64{5} << 30;
+
     catalog::FilePtr f{new catalog::File};
     f->_dependencies.insert(Oid{});
     f->_kind = catalog::File::Kind::cmm;
     f->_path = "x/y/z";
+    f->_size = size;
     Oid oid = i.put(std::move(f));
     f = catalog::objectPtrCast<catalog::File>(i.get(oid));
 
     EXPECT_TRUE(!!f);
     EXPECT_EQ(f->_kind, catalog::File::Kind::cmm);
     EXPECT_EQ(f->_path, "x/y/z");
+    EXPECT_EQ(f->_size, size);
+
+    const catalog::File* cf = catalog::objectPtrCast<catalog::File>(i.find(oid));
+    EXPECT_TRUE(!!cf);
+    EXPECT_EQ(cf->_path, "x/y/z");
+    EXPECT_TRUE(!i.find(Oid{}));
+
+    Catalog j;
+    j.deserialize(i.serialize());
+    f = catalog::objectPtrCast<catalog::File>(j.get(oid));
+
+    EXPECT_TRUE(!!f);
+    EXPECT_EQ(f->_size, size);
+}
+
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(aup, catalog_lazy)
+{
+    Catalog i;
+
+    std::vector<Oid> oids;
+    for(int n{}; n<10; ++n)
+    {
+        catalog::FilePtr f{new catalog::File};
+        f->_path = "f" + std::to_string(n);
+        f->_size = static_cast<dci::uint64>(n);
+        oids.push_back(i.put(std::move(f)));
+    }
+
+    //снимок разбирается по требованию
+    Catalog j;
+    j.deserialize(i.serialize());
+    EXPECT_EQ(j.enumerate(catalog::Object::Type::file).size(), oids.size());
+    EXPECT_TRUE(j.enumerate(catalog::Object::Type::release).empty());
+
+    const catalog::File* cf = catalog::objectPtrCast<catalog::File>(j.find(oids[3]));
+    EXPECT_TRUE(!!cf);
+    EXPECT_EQ(cf->_path, "f3");
+
+    j.del(oids[5]);
+    EXPECT_TRUE(!j.has(oids[5]));
+
+    //затронутые и нетронутые объекты переносятся в следующий снимок
+    Catalog k;
+    k.deserialize(j.serialize());
+    EXPECT_EQ(k.enumerate().size(), oids.size()-1);
+
+    for(std::size_t n{}; n<oids.size(); ++n)
+    {
+        catalog::FilePtr f = catalog::objectPtrCast<catalog::File>(k.get(oids[n]));
+        EXPECT_EQ(!!f, 5 != n);
+        if(f)
+        {
+            EXPECT_EQ(f->_path, "f" + std::to_string(n));
+        }
+    }
+}
+
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(aup, catalog_delta)
+{
+    std::string base(256*1024, '\0');
+    for(std::size_t n{}; n<base.size(); ++n)
+    {
+        base[n] = static_cast<char>((n * 2654435761u) >> 13);
+    }
+
+    //правка в середине и дописанный хвост
+    std::string target = base;
+    target.replace(100000, 16, "0123456789abcdef");
+    target += "tail";
+
+    dci::Bytes delta = catalog::makeDelta(base.data(), base.size(), target.data(), target.size());
+    EXPECT_LT(delta.size(), 1024u);
+
+    dci::Bytes restored = catalog::applyDelta(base.data(), base.size(), delta);
+    EXPECT_TRUE(catalog::identify(restored) == catalog::identify(target.data(), target.size()));
+    EXPECT_THROW(catalog::applyDelta(base.data(), base.size()-1, delta), Exception);
+
+    //потоковое применение отдает target кусками в порядке следования
+    std::string body(delta.size(), '\0');
+    dci::bytes::Cursor{delta.begin()}.read(body.data(), static_cast<dci::uint32>(body.size()));
+    std::string streamed;
+    catalog::applyDelta(base.data(), base.size(), body.data(), body.size(), [&](const dci::uint8* data, dci::uint64 size)
+    {
+        streamed.append(reinterpret_cast<const char*>(data), size);
+    });
+    EXPECT_EQ(streamed, target);
+    EXPECT_THROW(catalog::applyDelta(base.data(), base.size(), body.data(), body.size()-1, [](const dci::uint8*, dci::uint64){}), Exception);
+
+    Catalog i;
+
+    catalog::DeltaPtr d{new catalog::Delta};
+    d->_base = catalog::identify(base.data(), base.size());
+    d->_target = catalog::identify(target.data(), target.size());
+    d->_size = target.size();
+    d->_content = catalog::identify(delta);
+    Oid oid = i.put(std::move(d));
+
+    Catalog j;
+    j.deserialize(i.serialize());
+    d = catalog::objectPtrCast<catalog::Delta>(j.get(oid));
+
+    EXPECT_TRUE(!!d);
+    EXPECT_EQ(d->_size, target.size());
+    EXPECT_TRUE(d->_content == catalog::identify(delta));
+    EXPECT_EQ(j.enumerate(catalog::Object::Type::delta).size(), 1u);
+}
+
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(aup, catalog_identify)
+{
+    //одно и то же содержимое, поданное порциями разного размера, файлом и целиком
+    std::string content(3*1024*1024 + 12345, '\0');
+    for(std::size_t n{}; n<content.size(); ++n)
+    {
+        content[n] = static_cast<char>((n * 2654435761u) >> 11);
+    }
+
+    Oid whole = catalog::identify(content.data(), content.size());
+
+    dci::Bytes blob;
+    {
+        dci::bytes::Alter a{blob.end()};
+        std::size_t pos{};
+        for(std::size_t step{1}; pos < content.size(); step = step * 3 % 1048573 + 1)
+        {
+            std::size_t s = std::min(step, content.size() - pos);
+            a.write(content.data() + pos, static_cast<dci::uint32>(s));
+            pos += s;
+        }
+    }
+    EXPECT_TRUE(whole == catalog::identify(blob));
+
+    std::FILE* f = std::tmpfile();
+    EXPECT_EQ(std::fwrite(content.data(), 1, content.size(), f), content.size());
+    EXPECT_TRUE(whole == catalog::identify(f));
+    std::fclose(f);
+}
+
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(aup, catalog_chunked)
+{
+    std::string base(4*1024*1024, '\0');
+    for(std::size_t n{}; n<base.size(); ++n)
+    {
+        base[n] = static_cast<char>((n * 2654435761u) >> 9 ^ (n >> 7) * 40503u);
+    }
+
+    auto chunks = [](const std::string& content)
+    {
+        std::vector<Oid> res;
+
+        std::vector<dci::uint64> sizes = catalog::chunkSizes(content.data(), content.size());
+        dci::uint64 offset{};
+        for(std::size_t i{}; i<sizes.size(); ++i)
+        {
+            EXPECT_LE(sizes[i], 256u*1024);
+            if(i+1 < sizes.size())
+            {
+                EXPECT_GE(sizes[i], 16u*1024);
+            }
+
+            res.push_back(catalog::identify(content.data() + offset, sizes[i]));
+            offset += sizes[i];
+        }
+        EXPECT_EQ(offset, content.size());
+
+        return res;
+    };
+
+    //вставка в середину задевает лишь соседние куски
+    std::string target = base;
+    target.insert(2*1024*1024 + 17, "inserted");
+
+    std::vector<Oid> baseChunks = chunks(base);
+    std::vector<Oid> targetChunks = chunks(target);
+
+    std::size_t shared{};
+    for(const Oid& oid : targetChunks)
+    {
+        shared += std::count(baseChunks.begin(), baseChunks.end(), oid);
+    }
+    EXPECT_GE(shared + 3, targetChunks.size());
+    EXPECT_GT(targetChunks.size(), 8u);
+
+    Catalog i;
+
+    catalog::ChunkedPtr c{new catalog::Chunked};
+    c->_target = catalog::identify(target.data(), target.size());
+    c->_size = target.size();
+    c->_chunkSizes = catalog::chunkSizes(target.data(), target.size());
+    c->_chunks = targetChunks;
+    Oid oid = i.put(std::move(c));
+
+    Catalog j;
+    j.deserialize(i.serialize());
+    c = catalog::objectPtrCast<catalog::Chunked>(j.get(oid));
+
+    EXPECT_TRUE(!!c);
+    EXPECT_EQ(c->_size, target.size());
+    EXPECT_EQ(c->_chunks.size(), targetChunks.size());
+    EXPECT_EQ(j.enumerate(catalog::Object::Type::chunked).size(), 1u);
 }
@@ -0,0 +1,258 @@
+/* This file is part of the the dci project. Copyright (C) 2013-2023 vopl, shtoba.
+   This program is free software: you can redistribute it and/or modify it under the terms of the GNU Affero General Public
+   License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+   This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more details.
+   You should have received a copy of the GNU Affero General Public License along with this program. If not, see <https://www.gnu.org/licenses/>. */
+
+
+#include <dci/test.hpp>
+#include <dci/aup.hpp>
+using namespace dci::aup;
+using namespace dci;
+
+#include <dci/utils/b2h.hpp>
+#include <dci/crypto.hpp>
+#include <dci/crypto/ed25519.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <filesystem>
+
+namespace
+{
+    Bytes toBytes(const std::string& data)
+    {
+        Bytes res;
+        res.end().write(data.data(), static_cast<uint32>(data.size()));
+        return res;
+    }
+
+    std::string rndContent(std::size_t size)
+    {
+        std::string res(size, '\0');
+        crypto::rnd::generate(res.data(), res.size());
+        return res;
+    }
+
+    /* состояние экземпляра, заготовленное до старта
+     *
+     * объекты кладутся в каталог и хранилище напрямую, start подписывает релиз над всеми файлами
+     * случайным ключом, сохраняет каталог и поднимает экземпляр с целью, отбирающей всё
+     */
+    struct Stand
+    {
+        std::filesystem::path   _place = std::filesystem::temp_directory_path() / utils::b2h(crypto::rnd::generate(32));
+        Catalog                 _catalog;
+        Storage                 _storage;
+        Set<Oid>                _files;
+
+        Stand()
+        {
+            _storage.reset((_place / "state").string());
+        }
+
+        ~Stand()
+        {
+            if(instance::io::instanceInitialized())
+            {
+                instance::setup::stop();
+            }
+
+            std::filesystem::remove_all(_place);
+        }
+
+        Oid put(catalog::ObjectPtr&& object)
+        {
+            return _catalog.put(std::move(object));
+        }
+
+        Oid addFile(const std::string& content, const Set<Oid>& dependencies)
+        {
+            catalog::FilePtr f{new catalog::File};
+            f->_kind = catalog::File::Kind::runtime;
+            f->_path = "file" + std::to_string(_files.size());
+            f->_perms = 0644;
+            f->_size = content.size();
+            f->_content = catalog::identify(content.data(), content.size());
+            f->_dependencies = dependencies;
+
+            Oid oid = _catalog.put(std::move(f));
+            _files.insert(oid);
+            return oid;
+        }
+
+        void start()
+        {
+            catalog::UnitPtr u{new catalog::Unit};
+            u->_name = "unit";
+            u->_dependencies = _files;
+
+            catalog::ReleasePtr r{new catalog::Release};
+            r->_srcBranch = "master";
+            r->_dependencies.insert(_catalog.put(std::move(u)));
+
+            Array<uint8, 32> key;
+            crypto::rnd::generate(key.data(), key.size());
+            crypto::ed25519::mkPublic(key.data(), r->_signer.data());
+            Oid releaseHash = catalog::identify(r.get());
+            crypto::ed25519::sign(releaseHash.data(), releaseHash.size(), r->_signer.data(), key.data(), r->_signature.data());
+            _catalog.put(std::move(r));
+
+            _storage.put("catalog", _catalog.serialize());
+
+            boost::property_tree::ptree config;
+            config.put("targetDir", (_place / "target").string());
+            config.put("stateDir", (_place / "state").string());
+
+            boost::property_tree::ptree target;
+            for(const char* key : {"srcBranch", "srcRevision", "platformOs", "platformArch", "compiler", "compilerVersion",
+                                   "compilerOptimization", "provider", "stability", "signer", "unit", "fileKind"})
+            {
+                target.put(key, "*");
+            }
+            config.add_child("target", target);
+
+            instance::setup::start(config);
+        }
+    };
+}
+
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(aup, instance_ranges)
+{
+    Stand stand;
+
+    std::string content = rndContent(1024*1024);
+    Oid contentOid = catalog::identify(content.data(), content.size());
+
+    //две нарезки одного содержимого: по содержимому и пополам, граница половин не совпадает с границами первой
+    std::vector<uint64> sizes = catalog::chunkSizes(content.data(), content.size());
+    ASSERT_GT(sizes.size(), 2u);
+
+    uint64 half = sizes[0] + 1;
+    std::vector<uint64> halves = {half, content.size() - half};
+
+    Set<Oid> descriptions;
+    for(const std::vector<uint64>* s : {&sizes, &halves})
+    {
+        catalog::ChunkedPtr c{new catalog::Chunked};
+        c->_target = contentOid;
+        c->_size = content.size();
+
+        uint64 offset{};
+        for(uint64 size : *s)
+        {
+            c->_chunks.push_back(catalog::identify(content.data() + offset, size));
+            c->_chunkSizes.push_back(size);
+            offset += size;
+        }
+
+        descriptions.insert(stand.put(std::move(c)));
+    }
+
+    stand.addFile(content, descriptions);
+    stand.start();
+
+    EXPECT_TRUE(instance::io::targetStorageIncomplete().count(contentOid));
+    EXPECT_FALSE(instance::io::storageObjectChunks(contentOid).empty());
+
+    //по границам первой нарезки
+    EXPECT_TRUE(instance::io::verifyStorageObjectRange(contentOid, 0, toBytes(content.substr(0, sizes[0]))));
+    EXPECT_TRUE(instance::io::verifyStorageObjectRange(contentOid, sizes[0], toBytes(content.substr(sizes[0], sizes[1] + sizes[2]))));
+
+    //не на границе куска
+    EXPECT_FALSE(instance::io::verifyStorageObjectRange(contentOid, 1, toBytes(content.substr(1, sizes[0]))));
+    EXPECT_FALSE(instance::io::verifyStorageObjectRange(contentOid, 0, toBytes(content.substr(0, sizes[0] - 1))));
+    EXPECT_EQ(instance::io::putStorageObjectRange(contentOid, 1, toBytes(content.substr(1, sizes[0]))), instance::io::PutObjectResult::corrupted);
+
+    //испорченный кусок
+    std::string corrupted = content.substr(0, sizes[0]);
+    corrupted[corrupted.size()/2] ^= 1;
+    EXPECT_FALSE(instance::io::verifyStorageObjectRange(contentOid, 0, toBytes(corrupted)));
+    EXPECT_EQ(instance::io::putStorageObjectRange(contentOid, 0, toBytes(corrupted)), instance::io::PutObjectResult::corrupted);
+
+    //только по второй нарезке
+    EXPECT_TRUE(instance::io::verifyStorageObjectRange(contentOid, 0, toBytes(content.substr(0, half))));
+    EXPECT_TRUE(instance::io::verifyStorageObjectRange(contentOid, half, toBytes(content.substr(half))));
+
+    //кусок первой нарезки, затем обе половины второй - содержимое собирается
+    EXPECT_EQ(instance::io::putStorageObjectRange(contentOid, 0, toBytes(content.substr(0, sizes[0]))), instance::io::PutObjectResult::ok);
+    EXPECT_FALSE(instance::io::hasStorageObject(contentOid));
+    EXPECT_EQ(instance::io::putStorageObjectRange(contentOid, 0, toBytes(content.substr(0, half))), instance::io::PutObjectResult::ok);
+    EXPECT_EQ(instance::io::putStorageObjectRange(contentOid, half, toBytes(content.substr(half))), instance::io::PutObjectResult::ok);
+
+    EXPECT_TRUE(instance::io::hasStorageObject(contentOid));
+    EXPECT_TRUE(instance::io::targetStorageComplete().count(contentOid));
+
+    std::optional<Bytes> stored = instance::io::getStorageObject(contentOid);
+    ASSERT_TRUE(!!stored);
+    EXPECT_TRUE(catalog::identify(*stored) == contentOid);
+}
+
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(aup, instance_delta)
+{
+    Stand stand;
+
+    std::string base = rndContent(256*1024);
+    Oid baseOid = catalog::identify(base.data(), base.size());
+    stand._storage.put(baseOid, toBytes(base));
+
+    auto edit = [&](const std::string& text)
+    {
+        std::string res = base;
+        res.replace(1000, text.size(), text);
+        return res;
+    };
+
+    auto addDelta = [&](const std::string& target, const std::string& encoded)
+    {
+        Bytes body = catalog::makeDelta(base.data(), base.size(), encoded.data(), encoded.size());
+
+        catalog::DeltaPtr d{new catalog::Delta};
+        d->_base = baseOid;
+        d->_target = catalog::identify(target.data(), target.size());
+        d->_size = target.size();
+        d->_content = catalog::identify(body);
+
+        Oid bodyOid = d->_content;
+        stand.addFile(target, {stand.put(std::move(d))});
+        return std::make_pair(bodyOid, std::move(body));
+    };
+
+    //тело уже в хранилище - содержимое восстанавливается после построения индекса
+    std::string ready = edit("ready");
+    Oid readyOid = catalog::identify(ready.data(), ready.size());
+    auto readyBody = addDelta(ready, ready);
+    stand._storage.put(readyBody.first, std::move(readyBody.second));
+
+    //тела нет - запрашивается оно, содержимое восстанавливается по приходу
+    std::string deferred = edit("deferred");
+    Oid deferredOid = catalog::identify(deferred.data(), deferred.size());
+    auto deferredBody = addDelta(deferred, deferred);
+
+    //тело восстанавливает не то содержимое - запрашивается целиком
+    std::string wrong = edit("wrong");
+    Oid wrongOid = catalog::identify(wrong.data(), wrong.size());
+    auto wrongBody = addDelta(wrong, edit("WRONG"));
+    stand._storage.put(wrongBody.first, std::move(wrongBody.second));
+
+    stand.start();
+
+    EXPECT_TRUE(instance::io::hasStorageObject(readyOid));
+    EXPECT_TRUE(instance::io::targetStorageComplete().count(readyOid));
+    std::optional<Bytes> stored = instance::io::getStorageObject(readyOid);
+    ASSERT_TRUE(!!stored);
+    EXPECT_TRUE(catalog::identify(*stored) == readyOid);
+
+    EXPECT_FALSE(instance::io::hasStorageObject(deferredOid));
+    EXPECT_TRUE(instance::io::targetStorageIncomplete().count(deferredBody.first));
+    EXPECT_FALSE(instance::io::targetStorageIncomplete().count(deferredOid));
+
+    EXPECT_FALSE(instance::io::hasStorageObject(wrongOid));
+    EXPECT_TRUE(instance::io::targetStorageIncomplete().count(wrongOid));
+
+    EXPECT_EQ(instance::io::putStorageObject(deferredBody.first, std::move(deferredBody.second)), instance::io::PutObjectResult::ok);
+    EXPECT_TRUE(instance::io::hasStorageObject(deferredOid));
+    EXPECT_TRUE(instance::io::targetStorageComplete().count(deferredOid));
+    EXPECT_FALSE(instance::io::targetStorageIncomplete().count(deferredBody.first));
+}
@@ -60,6 +60,24 @@ namespace
 
         return true;
     }
+
+    bool checkMapping(const Oid& oid, const std::optional<storage::Mapping>& mapping)
+    {
+        if(!mapping || oid[0] != mapping->size())
+        {
+            return false;
+        }
+
+        for(uint8 i{0}; i<oid[0]; ++i)
+        {
+            if(oid[i % oid.size()] != mapping->data()[i])
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
 }
 
 /////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
@@ -81,6 +99,7 @@ TEST(aup, storage)
     {
         //std::cout<<utils::b2h(e.get())<<std::endl;
         EXPECT_TRUE(checkBlob(oid, *s.get(oid)));
+        EXPECT_TRUE(checkMapping(oid, s.map(oid)));
         s.del(oid);
         oids.erase(oid);
     }
@@ -88,3 +107,138 @@ TEST(aup, storage)
 
     s.delAll();
 }
+
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(aup, storage_packed)
+{
+    std::string place = (std::filesystem::temp_directory_path() / utils::b2h(crypto::rnd::generate(32))).string();
+
+    Storage s;
+    s.reset(place, true, true);
+
+    std::set<Oid> oids;
+    for(std::size_t i{}; i<10; ++i)
+    {
+        Oid oid = rndOid();
+        s.put(oid, makeBlob(oid));
+        oids.insert(oid);
+    }
+
+    EXPECT_TRUE(oids == s.enumerate());
+
+    //половину удалить и ужать
+    std::set<Oid> kept;
+    for(const Oid& oid : oids)
+    {
+        if(kept.size() < oids.size()/2)
+        {
+            kept.insert(oid);
+        }
+        else
+        {
+            EXPECT_TRUE(s.del(oid));
+        }
+    }
+
+    s.compact();
+
+    //переоткрыть с диска
+    s.reset(place, true, true);
+    EXPECT_TRUE(kept == s.enumerate());
+
+    for(const Oid& oid : kept)
+    {
+        EXPECT_TRUE(s.has(oid));
+        EXPECT_TRUE(checkBlob(oid, *s.get(oid)));
+        EXPECT_TRUE(checkMapping(oid, s.map(oid)));
+    }
+
+    s.delAll();
+}
+
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(aup, storage_batch)
+{
+    std::string place = (std::filesystem::temp_directory_path() / utils::b2h(crypto::rnd::generate(32))).string();
+
+    Storage s;
+    s.reset(place);
+
+    std::set<Oid> oids;
+    s.batchBegin();
+    for(std::size_t i{}; i<10; ++i)
+    {
+        Oid oid = rndOid();
+        s.put(oid, makeBlob(oid));
+        oids.insert(oid);
+
+        //видны до фиксации
+        EXPECT_TRUE(s.has(oid));
+        EXPECT_TRUE(checkBlob(oid, *s.get(oid)));
+    }
+
+    //удаление незафиксированного
+    EXPECT_TRUE(s.del(*oids.begin()));
+    oids.erase(oids.begin());
+
+    s.batchCommit();
+
+    //переоткрыть с диска
+    s.reset(place);
+    EXPECT_TRUE(oids == s.enumerate());
+
+    for(const Oid& oid : oids)
+    {
+        EXPECT_TRUE(checkBlob(oid, *s.get(oid)));
+    }
+
+    s.delAll();
+}
+
+/////////0/////////1/////////2/////////3/////////4/////////5/////////6/////////7
+TEST(aup, storage_compressed)
+{
+    std::string place = (std::filesystem::temp_directory_path() / utils::b2h(crypto::rnd::generate(32))).string();
+
+    Storage s;
+    s.reset(place, true, false, true);
+
+    //сжимаемое на несколько кадров и несжимаемое
+    std::string text;
+    while(text.size() < 700*1024)
+    {
+        text += "line " + std::to_string(text.size()) + " of some compressible content\n";
+    }
+    Oid textOid = rndOid();
+    s.put(textOid, Bytes{text.data(), text.size()});
+
+    Oid rndContentOid = rndOid();
+    Bytes rndContent = crypto::rnd::generate(64*1024);
+    s.put(rndContentOid, rndContent.clone());
+
+    uint64 footprint{};
+    for(const auto& de : std::filesystem::recursive_directory_iterator{place})
+    {
+        if(de.is_regular_file())
+        {
+            footprint += de.file_size();
+        }
+    }
+    EXPECT_LT(footprint, text.size() / 2 + rndContent.size() + 4096);
+
+    //переоткрыть без сжатия, читается прозрачно
+    s.reset(place);
+
+    EXPECT_TRUE(catalog::identify(*s.get(textOid)) == catalog::identify(text.data(), text.size()));
+    EXPECT_TRUE(catalog::identify(*s.get(rndContentOid)) == catalog::identify(rndContent));
+
+    //диапазон через границу кадров
+    uint64 offset = 256*1024 - 100;
+    EXPECT_TRUE(catalog::identify(*s.get(textOid, offset, 300)) == catalog::identify(text.data() + offset, 300));
+    EXPECT_TRUE(catalog::identify(*s.get(textOid, text.size() - 10)) == catalog::identify(text.data() + text.size() - 10, 10));
+
+    std::optional<storage::Mapping> m = s.map(textOid);
+    EXPECT_TRUE(m && m->size() == text.size() && !std::memcmp(m->data(), text.data(), text.size()));
+
+    s.delAll();
+}